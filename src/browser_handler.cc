@@ -1,18 +1,61 @@
 #include "browser_handler.h"
 #include <SDL3/sdl.h>
+#include <include/base/cef_bind.h>
+#include <include/base/cef_callback.h>
 #include <include/cef_scheme.h>
+#include <include/cef_task.h>
+#include <include/wrapper/cef_closure_task.h>
 #include <rpc.h>
 #include "browser_process_handler.h"
+#include "pixel_ops.h"
 #include "rpc.hpp"
 
 #include <windows.h>
+#include <algorithm>
 
 using json = nlohmann::json;
 
+namespace {
+
+// Upper bound for Browser.SetPaintOptions bufferCount.
+const int kMaxPaintBufferCount = 8;
+
+// Method carried by renderer messages that hold a single kind of request,
+// so the send queue can prioritize and coalesce them undecoded. Must match
+// the message names in render_process_handler.cc.
+RpcMethodId GetForwardedMethod(const std::string& messageName) {
+  if (messageName == "RenderProcessHandler.OnMouseOver") {
+    return RpcMethodId::Browser_OnMouseOver;
+  }
+  if (messageName == "RenderProcessHandler.OnFocus") {
+    return RpcMethodId::Browser_OnFocusedNodeChanged;
+  }
+  if (messageName == "RenderProcessHandler.OnFocusOut") {
+    return RpcMethodId::Browser_OnFocusOut;
+  }
+  if (messageName == "RenderProcessHandler.OnConsoleMessage") {
+    return RpcMethodId::Browser_OnConsoleMessage;
+  }
+  return RpcMethodId::Unknown;
+}
+
+}  // namespace
+
 BrowserHandler::BrowserHandler(BrowserProcessHandler* browserProcessHandler,
                                CefRect initialPageRectangle)
     : browserProcessHandler(browserProcessHandler),
-      initialPageRectangle(initialPageRectangle) {}
+      initialPageRectangle(initialPageRectangle),
+      viewSurfaces(browserProcessHandler->GetApplicationProcessHandle()),
+      popupSurfaces(browserProcessHandler->GetApplicationProcessHandle()),
+      paintBufferCount(1),
+      detectUnchangedTiles(false),
+      compositePopups(false),
+      compositeWidth(0),
+      compositeHeight(0),
+      popupWidth(0),
+      popupHeight(0),
+      popupVisible(false),
+      frameRateTickScheduled(false) {}
 
 void BrowserHandler::MarkCreated() {
   this->createdAt = std::chrono::steady_clock::now();
@@ -22,37 +65,138 @@ void BrowserHandler::MarkDestroyed() {
   this->destroyedAt = std::chrono::steady_clock::now();
 }
 
-std::optional<UUID> BrowserHandler::SendRpcRequest(
+void BrowserHandler::SetFrameRateBounds(
     CefRefPtr<CefBrowser> browser,
-    std::string methodName,
-    json arguments) {
+    const Browser_SetFrameRateBounds& bounds) {
+  if (!bounds.minFrameRate.has_value() || !bounds.maxFrameRate.has_value()) {
+    frameRateGovernor.Disable();
+    return;
+  }
+  frameRateGovernor.Enable(bounds.minFrameRate.value(),
+                           bounds.maxFrameRate.value());
+  this->GovernFrameRate(browser);
+  if (!frameRateTickScheduled) {
+    frameRateTickScheduled = true;
+    CefPostDelayedTask(TID_UI,
+                       base::BindOnce(&BrowserHandler::OnFrameRateTick,
+                                      CefRefPtr<BrowserHandler>(this), browser),
+                       FrameRateGovernor::kEvaluationIntervalMs);
+  }
+}
+
+void BrowserHandler::NotifyInput(CefRefPtr<CefBrowser> browser) {
+  if (frameRateGovernor.NotifyInput()) {
+    CefPostTask(TID_UI, base::BindOnce(&BrowserHandler::GovernFrameRate,
+                                       CefRefPtr<BrowserHandler>(this),
+                                       browser));
+  }
+}
+
+void BrowserHandler::NotifyHidden(bool hidden) {
+  frameRateGovernor.NotifyHidden(hidden);
+}
+
+void BrowserHandler::GovernFrameRate(CefRefPtr<CefBrowser> browser) {
+  if (destroyedAt.has_value()) {
+    return;
+  }
+  CefRefPtr<CefBrowserHost> host = browser->GetHost();
+  std::optional<int> frameRate =
+      frameRateGovernor.Evaluate(host->GetWindowlessFrameRate());
+  if (frameRate.has_value()) {
+    host->SetWindowlessFrameRate(frameRate.value());
+  }
+}
+
+void BrowserHandler::OnFrameRateTick(CefRefPtr<CefBrowser> browser) {
+  frameRateTickScheduled = false;
+  if (!frameRateGovernor.IsEnabled() || destroyedAt.has_value()) {
+    return;
+  }
+  this->GovernFrameRate(browser);
+  frameRateTickScheduled = true;
+  CefPostDelayedTask(TID_UI,
+                     base::BindOnce(&BrowserHandler::OnFrameRateTick,
+                                    CefRefPtr<BrowserHandler>(this), browser),
+                     FrameRateGovernor::kEvaluationIntervalMs);
+}
+
+void BrowserHandler::SetGeometry(CefRefPtr<CefBrowser> browser,
+                                 const Browser_SetGeometry& newGeometry) {
+  bool resized = !geometry.has_value() ||
+                 geometry->viewRect.width != newGeometry.viewRect.width ||
+                 geometry->viewRect.height != newGeometry.viewRect.height;
+  bool screenInfoChanged =
+      !geometry.has_value() ||
+      geometry->deviceScaleFactor != newGeometry.deviceScaleFactor ||
+      geometry->screenRect != newGeometry.screenRect ||
+      geometry->availableScreenRect != newGeometry.availableScreenRect;
+  geometry = newGeometry;
+  if (screenInfoChanged) {
+    browser->GetHost()->NotifyScreenInfoChanged();
+  }
+  if (resized) {
+    browser->GetHost()->WasResized();
+  }
+}
+
+bool BrowserHandler::SendRpcRequest(CefRefPtr<CefBrowser> browser,
+                                    RpcMethodId method,
+                                    OutgoingArguments arguments,
+                                    const RpcId& requestId) {
+  std::string methodName(GetRpcMethodInfo(method).methodName);
   if (!createdAt.has_value()) {
     browserProcessHandler->SendLogMessage(SDL_LOG_PRIORITY_WARN,
         "Attempted to send RPC request '" + methodName +
         "' but browser has not been created yet");
-    return std::nullopt;
+    return false;
   }
   if (destroyedAt.has_value()) {
     browserProcessHandler->SendLogMessage(SDL_LOG_PRIORITY_WARN,
         "Attempted to send RPC request '" + methodName +
         "' but browser has been destroyed");
-    return std::nullopt;
+    return false;
   }
-  RpcRequest request;
-  request.id = CreateUuid();
-  request.className = "Browser";
-  request.methodName = methodName;
+  OutgoingRequest request;
+  request.id = requestId;
+  request.method = method;
   request.instanceId = browser->GetIdentifier();
-  request.arguments = arguments;
-  json jsonRequest = request;
-  browserProcessHandler->SendMessage(jsonRequest.dump());
-  return request.id;
+  request.arguments = std::move(arguments);
+  return browserProcessHandler->SendRequest(std::move(request));
 }
 
-std::optional<UUID> BrowserHandler::SendRpcRequest(
+std::optional<RpcId> BrowserHandler::SendRpcRequest(
     CefRefPtr<CefBrowser> browser,
-    std::string methodName) {
-  return this->SendRpcRequest(browser, methodName, json::object());
+    RpcMethodId method,
+    OutgoingArguments arguments) {
+  RpcId requestId = NextRpcId();
+  if (!this->SendRpcRequest(browser, method, std::move(arguments),
+                            requestId)) {
+    return std::nullopt;
+  }
+  return requestId;
+}
+
+std::optional<RpcId> BrowserHandler::SendRpcRequest(
+    CefRefPtr<CefBrowser> browser,
+    RpcMethodId method) {
+  return this->SendRpcRequest(browser, method, json::object());
+}
+
+template <typename T>
+std::optional<T> BrowserHandler::CallRpc(CefRefPtr<CefBrowser> browser,
+                                         RpcMethodId method,
+                                         OutgoingArguments arguments) {
+  RpcId requestId = NextRpcId();
+  if (!browserProcessHandler->ExpectResponse(requestId)) {
+    return std::nullopt;
+  }
+  if (!this->SendRpcRequest(browser, method, std::move(arguments),
+                            requestId)) {
+    browserProcessHandler->CancelResponse(requestId);
+    return std::nullopt;
+  }
+  return browserProcessHandler->WaitForResponse<T>(method, requestId);
 }
 
 CefRefPtr<CefRenderHandler> BrowserHandler::GetRenderHandler() {
@@ -89,8 +233,11 @@ bool BrowserHandler::OnProcessMessageReceived(
     return false;
   }
   if (args->GetType(0) == VTYPE_STRING) {
-    std::string payload = args->GetString(0).ToString();
-    browserProcessHandler->BrowserProcessHandler::SendMessage(payload);
+    ForwardedJson forwarded;
+    forwarded.payload = args->GetString(0).ToString();
+    forwarded.method = GetForwardedMethod(message->GetName().ToString());
+    forwarded.instanceId = browser->GetIdentifier();
+    browserProcessHandler->ForwardJsonMessage(std::move(forwarded));
     return true;
   }
   return false;
@@ -102,14 +249,13 @@ void BrowserHandler::GetViewRect(CefRefPtr<CefBrowser> browser,
     rect = initialPageRectangle;
     return;
   }
-  std::optional<UUID> requestId = this->SendRpcRequest(browser, "GetViewRect");
-  if (!requestId.has_value()) {
-    rect = initialPageRectangle;
-  } else {
-    std::optional<CefRect> result =
-        browserProcessHandler->WaitForResponse<CefRect>(requestId.value());
-    rect = result.value_or(initialPageRectangle);
+  if (geometry.has_value()) {
+    rect = geometry->viewRect;
+    return;
   }
+  std::optional<CefRect> result =
+      this->CallRpc<CefRect>(browser, RpcMethodId::Browser_GetViewRect);
+  rect = result.value_or(initialPageRectangle);
 }
 
 void BrowserHandler::OnPaint(CefRefPtr<CefBrowser> browser,
@@ -118,52 +264,249 @@ void BrowserHandler::OnPaint(CefRefPtr<CefBrowser> browser,
                              const void* buffer,
                              int width,
                              int height) {
-  int bufferSize = width * height * 4;
-  HANDLE fileMapping = CreateFileMappingW(
-      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, bufferSize, NULL);
-  if (fileMapping == NULL) {
-    SDL_Log("Error creating file mapping for OnPaint buffer");
-    return;
+  const uint8_t* pixels = static_cast<const uint8_t*>(buffer);
+  if (!compositePopups) {
+    this->PaintFrame(browser, type, dirtyRects, pixels, width, height);
+  } else if (type == PET_POPUP) {
+    this->CompositePopup(browser, dirtyRects, pixels, width, height);
+  } else {
+    this->CompositeView(browser, dirtyRects, pixels, width, height);
   }
-  void* mappedView =
-      MapViewOfFile(fileMapping, FILE_MAP_WRITE, 0, 0, bufferSize);
-  if (mappedView == NULL) {
-    SDL_Log("Error mapping view of file for OnPaint buffer");
-    CloseHandle(fileMapping);
+}
+
+void BrowserHandler::PaintFrame(CefRefPtr<CefBrowser> browser,
+                                PaintElementType type,
+                                const RectList& dirtyRects,
+                                const uint8_t* source,
+                                int width,
+                                int height) {
+  PaintSurfacePool& pool = GetPaintSurfaces(type);
+  int outputWidth = ScaledPixelSize(width, paintConversion);
+  int outputHeight = ScaledPixelSize(height, paintConversion);
+  if (pool.EnsureSize(outputWidth, outputHeight, paintBufferCount)) {
+    this->AnnouncePaintSurfaces(browser, type, pool);
+  }
+  if (!pool.IsValid()) {
     return;
   }
-  memcpy(mappedView, buffer, bufferSize);
-  UnmapViewOfFile(mappedView);
 
-  HANDLE applicationProcessHandle =
-      browserProcessHandler->GetApplicationProcessHandle();
-  HANDLE duplicateHandle = NULL;
-  if (!DuplicateHandle(GetCurrentProcess(), fileMapping,
-                       applicationProcessHandle, &duplicateHandle, 0, FALSE,
-                       DUPLICATE_SAME_ACCESS)) {
-    SDL_Log("Error duplicating file mapping handle: DuplicateHandle() call failed");
-    CloseHandle(fileMapping);
+  std::vector<CefRect> damage = dirtyRects;
+  if (detectUnchangedTiles) {
+    damage = GetTileDamageFilter(type).Filter(source, width, height, damage);
+  }
+  if (paintConversion.scaleDivisor != 1) {
+    for (CefRect& rect : damage) {
+      rect = ScalePixelRect(rect, paintConversion);
+    }
+  }
+
+  // Only stale regions are copied, so the rectangles sent to the client are
+  // exactly what changed in this surface since it was last sent. A frame
+  // without real damage is not sent at all.
+  int bufferIndex = pool.AcquireSurface();
+  PaintSurfacePool::Surface& surface = pool.GetSurface(bufferIndex);
+  bool clientBehind = surface.pendingAcks > 0;
+  std::vector<CefRect> copyRects = pool.BeginFrame(bufferIndex, damage);
+  if (frameRateGovernor.NotifyFrame(!copyRects.empty(), clientBehind)) {
+    this->GovernFrameRate(browser);
+  }
+  if (copyRects.empty()) {
     return;
   }
+  for (const CefRect& rect : copyRects) {
+    ConvertPixelRect(surface.pixels, pool.GetStride(), source, width * 4, width,
+                     height, rect, paintConversion);
+  }
 
   Browser_OnPaint arguments;
   arguments.elementType = type;
-  arguments.width = width;
-  arguments.height = height;
-  arguments.sharedMemoryHandle = reinterpret_cast<uintptr_t>(duplicateHandle);
-  arguments.sharedMemorySize = bufferSize;
-  for (const auto& rect : dirtyRects) {
-    arguments.dirtyRects.push_back(rect);
-  }
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnPaint", jsonArguments);
-  if (!requestId.has_value()) {
-    CloseHandle(fileMapping);
+  arguments.width = outputWidth;
+  arguments.height = outputHeight;
+  arguments.bufferIndex = bufferIndex;
+  arguments.generation = pool.GetGeneration();
+  arguments.dirtyRects = copyRects;
+
+  bool sent = false;
+  if (pool.GetCount() == 1) {
+    // A single surface must not be written while the client reads it, so
+    // wait for the client to consume the frame.
+    sent = this->CallRpc<std::monostate>(browser, RpcMethodId::Browser_OnPaint,
+                                         std::move(arguments))
+               .has_value();
+  } else {
+    // Pipelined: return to CEF right away. The client recycles the surface
+    // with Browser.PaintAck.
+    sent = this->SendRpcRequest(browser, RpcMethodId::Browser_OnPaint,
+                                std::move(arguments))
+               .has_value();
+    if (sent) {
+      pool.MarkSent(bufferIndex);
+    }
+  }
+  if (!sent) {
+    // The client may not have seen the frame. Report its regions again with
+    // the next frame written to this surface.
+    surface.damage.insert(surface.damage.end(), copyRects.begin(),
+                          copyRects.end());
+  }
+}
+
+void BrowserHandler::CompositeView(CefRefPtr<CefBrowser> browser,
+                                   const RectList& dirtyRects,
+                                   const uint8_t* pixels,
+                                   int width,
+                                   int height) {
+  CefRect bounds(0, 0, width, height);
+  std::vector<CefRect> damage;
+  if (width != compositeWidth || height != compositeHeight) {
+    compositeWidth = width;
+    compositeHeight = height;
+    compositeFrame.resize(static_cast<size_t>(width) * height * 4);
+    damage.push_back(bounds);
+  } else {
+    damage = MergeDirtyRects(dirtyRects, bounds);
+  }
+  for (const CefRect& rect : damage) {
+    CopyPixelRect(compositeFrame.data(), width * 4, pixels, width * 4, rect);
+    BlitPopup(rect);
+  }
+  this->PaintFrame(browser, PET_VIEW, damage, compositeFrame.data(), width,
+                   height);
+}
+
+void BrowserHandler::CompositePopup(CefRefPtr<CefBrowser> browser,
+                                    const RectList& dirtyRects,
+                                    const uint8_t* pixels,
+                                    int width,
+                                    int height) {
+  popupWidth = width;
+  popupHeight = height;
+  popupFrame.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+  if (!popupVisible || compositeFrame.empty()) {
+    return;
+  }
+  std::vector<CefRect> damage;
+  for (const CefRect& rect : dirtyRects) {
+    damage.push_back(CefRect(popupRect.x + rect.x, popupRect.y + rect.y,
+                             rect.width, rect.height));
+  }
+  damage = MergeDirtyRects(damage,
+                           CefRect(0, 0, compositeWidth, compositeHeight));
+  for (const CefRect& rect : damage) {
+    BlitPopup(rect);
+  }
+  this->PaintFrame(browser, PET_VIEW, damage, compositeFrame.data(),
+                   compositeWidth, compositeHeight);
+}
+
+void BrowserHandler::BlitPopup(const CefRect& clip) {
+  if (!popupVisible || popupFrame.empty()) {
+    return;
+  }
+  int left = std::max({clip.x, popupRect.x, 0});
+  int top = std::max({clip.y, popupRect.y, 0});
+  int right = std::min({clip.x + clip.width, popupRect.x + popupWidth,
+                        compositeWidth});
+  int bottom = std::min({clip.y + clip.height, popupRect.y + popupHeight,
+                         compositeHeight});
+  if (right <= left || bottom <= top) {
+    return;
+  }
+  size_t stride = static_cast<size_t>(compositeWidth) * 4;
+  size_t popupStride = static_cast<size_t>(popupWidth) * 4;
+  CopyPixelRect(
+      compositeFrame.data() + top * stride + static_cast<size_t>(left) * 4,
+      stride,
+      popupFrame.data() + (top - popupRect.y) * popupStride +
+          static_cast<size_t>(left - popupRect.x) * 4,
+      popupStride, CefRect(0, 0, right - left, bottom - top));
+}
+
+PaintSurfacePool& BrowserHandler::GetPaintSurfaces(PaintElementType type) {
+  return type == PET_POPUP ? popupSurfaces : viewSurfaces;
+}
+
+TileDamageFilter& BrowserHandler::GetTileDamageFilter(PaintElementType type) {
+  return type == PET_POPUP ? popupTileFilter : viewTileFilter;
+}
+
+void BrowserHandler::SetPaintOptions(const Browser_SetPaintOptions& options) {
+  if (options.bufferCount.has_value()) {
+    paintBufferCount = std::clamp(options.bufferCount.value(), 1,
+                                  kMaxPaintBufferCount);
+  }
+  if (options.detectUnchangedTiles.has_value()) {
+    detectUnchangedTiles = options.detectUnchangedTiles.value();
+    // Hashes from before a gap would miss the frames painted in between.
+    viewTileFilter.Reset();
+    popupTileFilter.Reset();
+  }
+
+  PixelConversion conversion = paintConversion;
+  if (options.pixelFormat.has_value()) {
+    conversion.format = static_cast<PixelFormat>(
+        std::clamp(options.pixelFormat.value(), 0, 1));
+  }
+  if (options.premultipliedAlpha.has_value()) {
+    conversion.unpremultiply = !options.premultipliedAlpha.value();
+  }
+  if (options.scaleDivisor.has_value()) {
+    conversion.scaleDivisor = std::clamp(options.scaleDivisor.value(), 1, 2);
+  }
+  if (conversion.format != paintConversion.format ||
+      conversion.unpremultiply != paintConversion.unpremultiply ||
+      conversion.scaleDivisor != paintConversion.scaleDivisor) {
+    paintConversion = conversion;
+    // The next frame reallocates the surfaces and announces the new layout,
+    // rather than mixing layouts within one generation.
+    viewSurfaces.Reset();
+    popupSurfaces.Reset();
+  }
+
+  if (options.compositePopups.has_value() &&
+      options.compositePopups.value() != compositePopups) {
+    compositePopups = options.compositePopups.value();
+    // The first view frame after switching copies everything.
+    compositeFrame.clear();
+    compositeFrame.shrink_to_fit();
+    compositeWidth = 0;
+    compositeHeight = 0;
+    popupFrame.clear();
+    popupSurfaces.Reset();
+    popupTileFilter.Reset();
+  }
+}
+
+void BrowserHandler::AcknowledgePaint(const Browser_PaintAck& ack) {
+  GetPaintSurfaces(static_cast<PaintElementType>(ack.elementType))
+      .Acknowledge(ack.generation, ack.bufferIndex);
+}
+
+void BrowserHandler::AnnouncePaintSurfaces(CefRefPtr<CefBrowser> browser,
+                                           PaintElementType type,
+                                           PaintSurfacePool& pool) {
+  if (!pool.IsValid()) {
     return;
   }
-  browserProcessHandler->WaitForResponse<std::monostate>(requestId.value());
-  CloseHandle(fileMapping);
+  Browser_OnPaintSurfaceCreated arguments;
+  arguments.elementType = type;
+  arguments.generation = pool.GetGeneration();
+  arguments.width = pool.GetWidth();
+  arguments.height = pool.GetHeight();
+  arguments.stride = pool.GetStride();
+  arguments.pixelFormat = static_cast<int>(paintConversion.format);
+  arguments.premultipliedAlpha = !paintConversion.unpremultiply;
+  for (int i = 0; i < pool.GetCount(); ++i) {
+    Browser_PaintSurface surface;
+    surface.sharedMemoryHandle = pool.GetSurface(i).clientHandle;
+    surface.sharedMemorySize = pool.GetSurfaceSize();
+    arguments.surfaces.push_back(surface);
+  }
+  if (!this->SendRpcRequest(browser, RpcMethodId::Browser_OnPaintSurfaceCreated,
+                            std::move(arguments))) {
+    // Frames must not name surfaces the client never received.
+    pool.Discard();
+  }
 }
 
 void BrowserHandler::OnAcceleratedPaint(CefRefPtr<CefBrowser> browser,
@@ -184,13 +527,8 @@ void BrowserHandler::OnAcceleratedPaint(CefRefPtr<CefBrowser> browser,
   arguments.elementType = type;
   arguments.format = info.format;
   arguments.sharedTextureHandle = reinterpret_cast<uintptr_t>(duplicateHandle);
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnAcceleratedPaint", jsonArguments);
-  if (!requestId.has_value()) {
-    return;
-  }
-  browserProcessHandler->WaitForResponse<std::monostate>(requestId.value());
+  this->CallRpc<std::monostate>(
+      browser, RpcMethodId::Browser_OnAcceleratedPaint, std::move(arguments));
 }
 
 void BrowserHandler::OnTextSelectionChanged(CefRefPtr<CefBrowser> browser,
@@ -200,13 +538,25 @@ void BrowserHandler::OnTextSelectionChanged(CefRefPtr<CefBrowser> browser,
   arguments.selectedText = selected_text.ToString();
   arguments.selectedRangeFrom = selected_range.from;
   arguments.selectedRangeTo = selected_range.to;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnTextSelectionChanged", jsonArguments);
+  this->SendRpcRequest(browser, RpcMethodId::Browser_OnTextSelectionChanged,
+                       std::move(arguments));
 }
 
 bool BrowserHandler::GetScreenInfo(CefRefPtr<CefBrowser> browser,
                                    CefScreenInfo& screen_info) {
-  return false;
+  if (!geometry.has_value()) {
+    return false;
+  }
+  screen_info.device_scale_factor = geometry->deviceScaleFactor;
+  // The view is not the screen; leave CEF's defaults unless the client sent
+  // the real bounds.
+  if (geometry->screenRect.has_value()) {
+    screen_info.rect = *geometry->screenRect;
+  }
+  if (geometry->availableScreenRect.has_value()) {
+    screen_info.available_rect = *geometry->availableScreenRect;
+  }
+  return true;
 }
 
 bool BrowserHandler::GetScreenPoint(CefRefPtr<CefBrowser> browser,
@@ -214,15 +564,18 @@ bool BrowserHandler::GetScreenPoint(CefRefPtr<CefBrowser> browser,
                                     int viewY,
                                     int& screenX,
                                     int& screenY) {
+  if (geometry.has_value()) {
+    // View coordinates are in DIPs, screen coordinates in device pixels.
+    screenX = geometry->screenOrigin.x +
+              static_cast<int>(viewX * geometry->deviceScaleFactor);
+    screenY = geometry->screenOrigin.y +
+              static_cast<int>(viewY * geometry->deviceScaleFactor);
+    return true;
+  }
   Browser_GetScreenPoint arguments;
   arguments.view = CefPoint(viewX, viewY);
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "GetScreenPoint", jsonArguments);
-  if (!requestId.has_value()) {
-    return false;
-  }
-  std::optional<CefPoint> result = browserProcessHandler->WaitForResponse<CefPoint>(requestId.value());
+  std::optional<CefPoint> result = this->CallRpc<CefPoint>(
+      browser, RpcMethodId::Browser_GetScreenPoint, std::move(arguments));
   if (!result.has_value()) {
     return false;
   }
@@ -233,26 +586,46 @@ bool BrowserHandler::GetScreenPoint(CefRefPtr<CefBrowser> browser,
 }
 
 void BrowserHandler::OnPopupShow(CefRefPtr<CefBrowser> browser, bool show) {
+  popupVisible = show;
+  if (!show) {
+    popupFrame.clear();
+  }
+  if (compositePopups) {
+    // CEF repaints the view, which uncovers what the popup hid.
+    if (!show) {
+      browser->GetHost()->Invalidate(PET_VIEW);
+    }
+    return;
+  }
   Browser_OnPopupShow arguments;
   arguments.show = show;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnPopupShow", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnPopupShow, std::move(arguments));
 }
 
 void BrowserHandler::OnPopupSize(CefRefPtr<CefBrowser> browser,
                                  const CefRect& rect) {
+  if (compositePopups) {
+    // The popup may have moved off part of the view.
+    if (popupVisible && !popupFrame.empty()) {
+      browser->GetHost()->Invalidate(PET_VIEW);
+    }
+    popupRect = rect;
+    return;
+  }
+  popupRect = rect;
   Browser_OnPopupSize arguments;
   arguments.rectangle = rect;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnPopupSize", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnPopupSize, std::move(arguments));
 }
 
 void BrowserHandler::OnTitleChange(CefRefPtr<CefBrowser> browser,
                                    const CefString& title) {
   Browser_OnTitleChange arguments;
   arguments.title = title.ToString();
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnTitleChange", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnTitleChange, std::move(arguments));
 }
 
 bool BrowserHandler::OnConsoleMessage(CefRefPtr<CefBrowser> browser,
@@ -265,8 +638,8 @@ bool BrowserHandler::OnConsoleMessage(CefRefPtr<CefBrowser> browser,
   arguments.message = message.ToString();
   arguments.source = source.ToString();
   arguments.line = line;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnConsoleMessage", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnConsoleMessage, std::move(arguments));
   return true;
 }
 
@@ -274,8 +647,8 @@ void BrowserHandler::OnLoadingProgressChange(CefRefPtr<CefBrowser> browser,
                                              double progress) {
   Browser_OnLoadingProgressChange arguments;
   arguments.progress = progress;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnLoadingProgressChange", jsonArguments);
+  this->SendRpcRequest(browser, RpcMethodId::Browser_OnLoadingProgressChange,
+                       std::move(arguments));
 }
 
 void BrowserHandler::OnFaviconURLChange(
@@ -285,8 +658,8 @@ void BrowserHandler::OnFaviconURLChange(
   for (const auto& url : icon_urls) {
     arguments.iconUrls.push_back(url.ToString());
   }
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnFaviconUrlChange", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnFaviconUrlChange, std::move(arguments));
 }
 
 bool BrowserHandler::OnCursorChange(CefRefPtr<CefBrowser> browser,
@@ -295,8 +668,8 @@ bool BrowserHandler::OnCursorChange(CefRefPtr<CefBrowser> browser,
                                     const CefCursorInfo& custom_cursor_info) {
   Browser_OnCursorChange arguments;
   arguments.cursorType = static_cast<int>(type);
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnCursorChange", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnCursorChange, std::move(arguments));
   return true;
 }
 
@@ -305,13 +678,11 @@ bool BrowserHandler::DoClose(CefRefPtr<CefBrowser> browser) {
 }
 
 void BrowserHandler::OnBeforeClose(CefRefPtr<CefBrowser> browser) {
+  // Sent before marking the browser destroyed, which makes SendRpcRequest
+  // refuse.
+  this->CallRpc<std::monostate>(browser, RpcMethodId::Browser_OnBeforeClose);
   this->MarkDestroyed();
   browserProcessHandler->RemoveBrowserHandler(browser->GetIdentifier());
-  std::optional<UUID> requestId = this->SendRpcRequest(browser, "OnBeforeClose");
-  if (!requestId.has_value()) {
-    return;
-  }
-  browserProcessHandler->WaitForResponse<std::monostate>(requestId.value());
 }
 
 bool BrowserHandler::OnBeforePopup(
@@ -333,14 +704,8 @@ bool BrowserHandler::OnBeforePopup(
   arguments.targetFrameName = target_frame_name.ToString();
   arguments.targetDisposition = static_cast<int>(target_disposition);
   arguments.userGesture = user_gesture;
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnBeforePopup", jsonArguments);
-  if (!requestId.has_value()) {
-    return true;
-  }
-  std::optional<bool> result =
-      browserProcessHandler->WaitForResponse<bool>(requestId.value());
+  std::optional<bool> result = this->CallRpc<bool>(
+      browser, RpcMethodId::Browser_OnBeforePopup, std::move(arguments));
   return result.value_or(true);
 }
 
@@ -363,14 +728,8 @@ bool BrowserHandler::OnBeforeBrowse(
   arguments.isRedirect = is_redirect;
   arguments.transitionType = static_cast<int>(request->GetTransitionType());
   arguments.resourceType = static_cast<int>(request->GetResourceType());
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnBeforeBrowse", jsonArguments);
-  if (!requestId.has_value()) {
-    return false;
-  }
-  std::optional<bool> result =
-      browserProcessHandler->WaitForResponse<bool>(requestId.value());
+  std::optional<bool> result = this->CallRpc<bool>(
+      browser, RpcMethodId::Browser_OnBeforeBrowse, std::move(arguments));
   return result.value_or(false);
 }
 
@@ -384,14 +743,8 @@ bool BrowserHandler::OnOpenURLFromTab(
   arguments.targetUrl = target_url.ToString();
   arguments.targetDisposition = static_cast<int>(target_disposition);
   arguments.userGesture = user_gesture;
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnOpenUrlFromTab", jsonArguments);
-  if (!requestId.has_value()) {
-    return true;
-  }
-  std::optional<bool> result =
-      browserProcessHandler->WaitForResponse<bool>(requestId.value());
+  std::optional<bool> result = this->CallRpc<bool>(
+      browser, RpcMethodId::Browser_OnOpenUrlFromTab, std::move(arguments));
   return result.value_or(true);
 }
 
@@ -407,14 +760,10 @@ void BrowserHandler::OnBeforeContextMenu(CefRefPtr<CefBrowser> browser,
       static_cast<int>(params->GetMediaStateFlags());
   arguments.nodeEditFlags = static_cast<int>(params->GetEditStateFlags());
   arguments.selectionText = params->GetSelectionText().ToString();
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId = this->SendRpcRequest(browser, "OnBeforeContextMenu", jsonArguments);
-  if (!requestId.has_value()) {
-    return;
-  }
   std::optional<ContextMenuConfiguration> result =
-      browserProcessHandler->WaitForResponse<ContextMenuConfiguration>(
-          requestId.value());
+      this->CallRpc<ContextMenuConfiguration>(
+          browser, RpcMethodId::Browser_OnBeforeContextMenu,
+          std::move(arguments));
   if (!result.has_value()) {
     return;
   }
@@ -441,14 +790,8 @@ bool BrowserHandler::OnContextMenuCommand(CefRefPtr<CefBrowser> browser,
                                          cef_event_flags_t eventFlags) {
   Browser_OnContextMenuCommand arguments;
   arguments.commandId = commandId;
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnContextMenuCommand", jsonArguments);
-  if (!requestId.has_value()) {
-    return false;
-  }
-  std::optional<bool> result =
-      browserProcessHandler->WaitForResponse<bool>(requestId.value());
+  std::optional<bool> result = this->CallRpc<bool>(
+      browser, RpcMethodId::Browser_OnContextMenuCommand, std::move(arguments));
   return result.value_or(false);
 }
 
@@ -460,8 +803,8 @@ void BrowserHandler::OnLoadingStateChange(CefRefPtr<CefBrowser> browser,
   arguments.isLoading = isLoading;
   arguments.canGoBack = canGoBack;
   arguments.canGoForward = canGoForward;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnLoadingStateChange", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnLoadingStateChange, std::move(arguments));
 }
 
 void BrowserHandler::OnLoadStart(CefRefPtr<CefBrowser> browser,
@@ -472,9 +815,9 @@ void BrowserHandler::OnLoadStart(CefRefPtr<CefBrowser> browser,
   }
   Browser_OnLoadStart arguments;
   arguments.transitionType = static_cast<int>(transition_type);
-  json jsonArguments = arguments;
-  std::optional<UUID> requestId =
-      this->SendRpcRequest(browser, "OnLoadStart", jsonArguments);
+  std::optional<RpcId> requestId =
+      this->SendRpcRequest(
+          browser, RpcMethodId::Browser_OnLoadStart, std::move(arguments));
 }
 
 void BrowserHandler::OnLoadEnd(CefRefPtr<CefBrowser> browser,
@@ -485,8 +828,8 @@ void BrowserHandler::OnLoadEnd(CefRefPtr<CefBrowser> browser,
   }
   Browser_OnLoadEnd arguments;
   arguments.httpStatusCode = httpStatusCode;
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnLoadEnd", jsonArguments);
+  this->SendRpcRequest(browser, RpcMethodId::Browser_OnLoadEnd,
+                       std::move(arguments));
 }
 
 void BrowserHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
@@ -501,15 +844,15 @@ void BrowserHandler::OnLoadError(CefRefPtr<CefBrowser> browser,
   arguments.errorCode = static_cast<int>(errorCode);
   arguments.errorText = errorText.ToString();
   arguments.failedUrl = failedUrl.ToString();
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnLoadError", jsonArguments);
+  this->SendRpcRequest(
+      browser, RpcMethodId::Browser_OnLoadError, std::move(arguments));
 }
 
 bool BrowserHandler::OnTooltip(CefRefPtr<CefBrowser> browser,
                                CefString& text) {
   Browser_OnTooltip arguments;
   arguments.text = text.ToString();
-  json jsonArguments = arguments;
-  this->SendRpcRequest(browser, "OnTooltip", jsonArguments);
+  this->SendRpcRequest(browser, RpcMethodId::Browser_OnTooltip,
+                       std::move(arguments));
   return true;
 }
\ No newline at end of file
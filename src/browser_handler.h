@@ -9,8 +9,12 @@
 #include <vector>
 
 #include "include/cef_client.h"
+#include "frame_rate_governor.h"
+#include "outgoing_message.hpp"
+#include "paint_surface_pool.h"
+#include "pixel_ops.h"
 #include "rpc.hpp"
-#include "thread_safe_queue.hpp"
+#include "tile_damage_filter.h"
 
 class BrowserProcessHandler;
 
@@ -27,11 +31,30 @@ class BrowserHandler : public CefClient,
   
   void MarkCreated();
   void MarkDestroyed();
-  std::optional<UUID> SendRpcRequest(CefRefPtr<CefBrowser> browser_,
-                                     std::string methodName,
-                                     json arguments);
-  std::optional<UUID> SendRpcRequest(CefRefPtr<CefBrowser> browser_,
-                                     std::string methodName);
+  // Caches client-pushed geometry so GetViewRect, GetScreenPoint and
+  // GetScreenInfo no longer need a round trip. UI thread only.
+  void SetGeometry(CefRefPtr<CefBrowser> browser_,
+                   const Browser_SetGeometry& geometry);
+  // Adaptive frame rate. SetFrameRateBounds runs on the UI thread,
+  // NotifyInput and NotifyHidden on any thread.
+  void SetFrameRateBounds(CefRefPtr<CefBrowser> browser_,
+                          const Browser_SetFrameRateBounds& bounds);
+  void NotifyInput(CefRefPtr<CefBrowser> browser_);
+  void NotifyHidden(bool hidden);
+  // Paint pipelining, UI thread only.
+  void SetPaintOptions(const Browser_SetPaintOptions& options);
+  void AcknowledgePaint(const Browser_PaintAck& ack);
+  std::optional<RpcId> SendRpcRequest(CefRefPtr<CefBrowser> browser_,
+                                     RpcMethodId method,
+                                     OutgoingArguments arguments);
+  std::optional<RpcId> SendRpcRequest(CefRefPtr<CefBrowser> browser_,
+                                     RpcMethodId method);
+  // Sends a request and blocks until the client responds. Returns nullopt if
+  // the request could not be sent or the response did not decode as T.
+  template <typename T>
+  std::optional<T> CallRpc(CefRefPtr<CefBrowser> browser_,
+                           RpcMethodId method,
+                           OutgoingArguments arguments = json::object());
 
   // CefClient:
   CefRefPtr<CefRenderHandler> GetRenderHandler() override;
@@ -157,12 +180,63 @@ class BrowserHandler : public CefClient,
                    const CefString& failedUrl) override;
 
  private:
+  bool SendRpcRequest(CefRefPtr<CefBrowser> browser_,
+                      RpcMethodId method,
+                      OutgoingArguments arguments,
+                      const RpcId& requestId);
+  PaintSurfacePool& GetPaintSurfaces(PaintElementType type);
+  TileDamageFilter& GetTileDamageFilter(PaintElementType type);
+  void AnnouncePaintSurfaces(CefRefPtr<CefBrowser> browser_,
+                             PaintElementType type,
+                             PaintSurfacePool& pool);
+  void PaintFrame(CefRefPtr<CefBrowser> browser_,
+                  PaintElementType type,
+                  const RectList& dirtyRects,
+                  const uint8_t* pixels,
+                  int width,
+                  int height);
+  void CompositeView(CefRefPtr<CefBrowser> browser_,
+                     const RectList& dirtyRects,
+                     const uint8_t* pixels,
+                     int width,
+                     int height);
+  void CompositePopup(CefRefPtr<CefBrowser> browser_,
+                      const RectList& dirtyRects,
+                      const uint8_t* pixels,
+                      int width,
+                      int height);
+  void BlitPopup(const CefRect& clip);
+  void GovernFrameRate(CefRefPtr<CefBrowser> browser_);
+  void OnFrameRateTick(CefRefPtr<CefBrowser> browser_);
+
   using TimePoint = std::chrono::steady_clock::time_point;
 
   BrowserProcessHandler* browserProcessHandler;
   CefRect initialPageRectangle;
   std::optional<TimePoint> createdAt;
   std::optional<TimePoint> destroyedAt;
+  std::optional<Browser_SetGeometry> geometry;
+  PaintSurfacePool viewSurfaces;
+  PaintSurfacePool popupSurfaces;
+  TileDamageFilter viewTileFilter;
+  TileDamageFilter popupTileFilter;
+  // Surfaces per element type; more than one pipelines OnPaint.
+  int paintBufferCount;
+  bool detectUnchangedTiles;
+  PixelConversion paintConversion;
+  // With popup compositing, the view as sent to the client: CEF's view
+  // pixels with the last popup frame drawn over them at popupRect.
+  bool compositePopups;
+  std::vector<uint8_t> compositeFrame;
+  int compositeWidth;
+  int compositeHeight;
+  std::vector<uint8_t> popupFrame;
+  int popupWidth;
+  int popupHeight;
+  CefRect popupRect;
+  bool popupVisible;
+  FrameRateGovernor frameRateGovernor;
+  bool frameRateTickScheduled;
 
   IMPLEMENT_REFCOUNTING(BrowserHandler);
 };
\ No newline at end of file
@@ -9,7 +9,6 @@
 #include <variant>
 
 #include <SDL3/sdl.h>
-#include <SDL3_net/SDL_net.h>
 #include <include/base/cef_bind.h>
 #include <include/base/cef_callback.h>
 #include <include/cef_parser.h>
@@ -19,19 +18,32 @@
 
 #include "browser_handler.h"
 #include "browser_process_handler.h"
-#include "guid_ext.hpp"
+#include "command_line_switches.h"
+#include "receive_buffer.hpp"
 #include "rpc.hpp"
-#include "thread_safe_queue.hpp"
+#include "wire_encoding.hpp"
 
 using json = nlohmann::json;
 
 const char kEvalMessage[] = "Eval";
 
+// Receive path sizing. Frames larger than kMaxRpcFrameSize are treated as a
+// corrupt stream since the framing cannot be resynchronized.
+const size_t kReceiveBufferInitialSize = 256 * 1024;
+const size_t kReceiveReadSize = 64 * 1024;
+const uint32_t kMaxRpcFrameSize = 64 * 1024 * 1024;
+
+// How long CEF threads wait for the client to answer a synchronous request
+// before falling back to a default, unless the client configures otherwise
+// through Client.SetResponseTimeouts.
+const uint32_t kDefaultResponseTimeoutMs = 5000;
+const uint32_t kUseDefaultResponseTimeout = UINT32_MAX;
+
 // Callback for CefBrowserHost::DownloadImage
 class DownloadImageCallback : public CefDownloadImageCallback {
  public:
   DownloadImageCallback(BrowserProcessHandler* handler,
-                        const UUID& requestId,
+                        const RpcId& requestId,
                         const std::string& imageUrl)
       : handler(handler), requestId(requestId), imageUrl(imageUrl) {}
 
@@ -64,14 +76,19 @@ class DownloadImageCallback : public CefDownloadImageCallback {
     response.requestId = requestId;
     response.success = true;
     response.returnValue = arguments;
+    WireEncoding encoding = handler->GetWireEncoding();
+    for (size_t i = 0; i < arguments.images.size(); ++i) {
+      response.returnValue["images"][i]["data"] =
+          BytesToJson(arguments.images[i].data, encoding);
+    }
     json jsonResponse = response;
 
-    handler->SendMessage(jsonResponse.dump());
+    handler->SendMessage(std::move(jsonResponse));
   }
 
  private:
   BrowserProcessHandler* handler;
-  UUID requestId;
+  RpcId requestId;
   std::string imageUrl;
 
   IMPLEMENT_REFCOUNTING(DownloadImageCallback);
@@ -80,7 +97,7 @@ class DownloadImageCallback : public CefDownloadImageCallback {
 // Callback for CefFrame::GetSource
 class GetSourceStringVisitor : public CefStringVisitor {
  public:
-  GetSourceStringVisitor(BrowserProcessHandler* handler, const UUID& requestId)
+  GetSourceStringVisitor(BrowserProcessHandler* handler, const RpcId& requestId)
       : handler(handler), requestId(requestId) {}
 
   void Visit(const CefString& string) override {
@@ -89,12 +106,12 @@ class GetSourceStringVisitor : public CefStringVisitor {
     response.success = true;
     response.returnValue = string.ToString();
     json jsonResponse = response;
-    handler->SendMessage(jsonResponse.dump());
+    handler->SendMessage(std::move(jsonResponse));
   }
 
  private:
   BrowserProcessHandler* handler;
-  UUID requestId;
+  RpcId requestId;
 
   IMPLEMENT_REFCOUNTING(GetSourceStringVisitor);
 };
@@ -102,47 +119,45 @@ class GetSourceStringVisitor : public CefStringVisitor {
 BrowserProcessHandler::BrowserProcessHandler(
     HANDLE applicationProcessHandle,
     HWND applicationMessageWindowHandle,
-    int windowMessageId)
+    int windowMessageId,
+    std::unique_ptr<RpcTransport> transport)
     : applicationProcessHandle(applicationProcessHandle),
       applicationMessageWindowHandle(applicationMessageWindowHandle),
       windowMessageId(windowMessageId),
       outgoingMessageQueue(),
-      responseMapMutex(SDL_CreateMutex()),
-      socketServer(NULL),
-      browserEntries(),
+      wireEncoding(WireEncoding::Json),
+      browsers(),
       isShuttingDown(false),
-      streamSocket(nullptr) {}
-
-BrowserProcessHandler::~BrowserProcessHandler() {
-  SDL_DestroyMutex(responseMapMutex);
-  responseMapMutex = nullptr;
+      nextRpcIdPrefix(0),
+      transport(std::move(transport)),
+      defaultResponseTimeoutMs(kDefaultResponseTimeoutMs),
+      responseTimeoutCount(0),
+      lateResponseCount(0) {
+  for (std::atomic<uint32_t>& timeout : responseTimeoutsMs) {
+    timeout.store(kUseDefaultResponseTimeout);
+  }
 }
 
-NET_Server* BrowserProcessHandler::GetSocketServer() {
-  return socketServer;
+BrowserProcessHandler::~BrowserProcessHandler() {}
+
+RpcTransport* BrowserProcessHandler::GetTransport() {
+  return transport.get();
 }
 
 CefRefPtr<CefBrowser> BrowserProcessHandler::GetBrowser(int browserId) {
-  auto it = browserEntries.find(browserId);
-  if (it != browserEntries.end()) {
-    return it->second.second;
-  }
-  return nullptr;
+  return browsers.GetBrowser(browserId);
 }
 
 CefRefPtr<BrowserHandler> BrowserProcessHandler::GetBrowserHandler(
     int browserId) {
-  auto it = browserEntries.find(browserId);
-  if (it != browserEntries.end()) {
-    return it->second.first;
-  }
-  return nullptr;
+  return browsers.GetHandler(browserId);
 }
 
 void BrowserProcessHandler::RemoveBrowserHandler(int browserId) {
-  browserEntries.erase(browserId);
+  browsers.Remove(browserId);
+  outgoingMessageQueue.RemoveBrowser(browserId);
 
-  if (isShuttingDown && browserEntries.empty()) {
+  if (isShuttingDown && browsers.GetCount() == 0) {
     CefPostTask(TID_UI, base::BindOnce([]() { CefQuitMessageLoop(); }));
   }
 }
@@ -164,6 +179,18 @@ int BrowserProcessHandler::GetWindowMessageId() {
   return this->windowMessageId;
 }
 
+void BrowserProcessHandler::OnBeforeChildProcessLaunch(
+    CefRefPtr<CefCommandLine> command_line) {
+  // Renderers generate request ids too and must use the same format, each
+  // with a prefix of its own.
+  if (GetRpcIdFormat() == RpcIdFormat::Uuid) {
+    command_line->AppendSwitch(switches::kRpcUuidRequestIds);
+  }
+  uint32_t prefix = nextRpcIdPrefix.fetch_add(1) % kMaxRpcIdPrefix + 1;
+  command_line->AppendSwitchWithValue(switches::kRpcIdPrefix,
+                                      std::to_string(prefix));
+}
+
 void BrowserProcessHandler::OnContextInitialized() {
   this->CefBrowserProcessHandler::OnContextInitialized();
 
@@ -172,19 +199,10 @@ void BrowserProcessHandler::OnContextInitialized() {
     abort();
   }
 
-  if (!NET_Init()) {
-    SDL_Log(SDL_GetError());
-    abort();
-  }
-
-  socketServer = NET_CreateServer(NULL, 3000);
-  if (socketServer == NULL) {
-    SDL_Log(SDL_GetError());
+  if (!transport->Listen()) {
     abort();
   }
 
-  SDL_Log("Server started on port 3000");
-
   // Signal that the server is ready, then block until a client connects.
   HANDLE hEvent = OpenEvent(EVENT_MODIFY_STATE, FALSE, L"ChromiumSocketReady");
   if (hEvent == NULL) {
@@ -198,18 +216,10 @@ void BrowserProcessHandler::OnContextInitialized() {
   CloseHandle(hEvent);
 
   // Wait for a client to connect before spawning I/O threads.
-  void* waitSockets[] = {static_cast<void*>(socketServer)};
-  NET_WaitUntilInputAvailable(waitSockets, 1, -1);
-
-  if (!NET_AcceptClient(socketServer, &streamSocket)) {
-    SDL_Log("Accept error: %s", SDL_GetError());
-    abort();
-  }
-  if (!streamSocket) {
-    SDL_Log("No client connected after WaitUntilInputAvailable");
+  if (!transport->Accept()) {
     abort();
   }
-  SDL_Log("Client connected!");
+  SDL_Log("Client connected over %s transport!", transport->GetName());
 
   SDL_Thread* receiveThread =
       SDL_CreateThread(RpcReceiveThread, "CefRpcReceive", this);
@@ -225,20 +235,46 @@ void BrowserProcessHandler::OnContextInitialized() {
   }
 }
 
-void BrowserProcessHandler::Client_CreateBrowserRpc(const UUID& requestId,
-                                                    const CefString& url,
-                                                    const CefRect& rectangle,
-                                                    HWND parentWindowHandle,
-                                                    bool windowless,
-                                                    bool hardwareAccelerated) {
+void BrowserProcessHandler::Client_HandshakeRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Client_Handshake& arguments) {
+  WireEncoding encoding =
+      WireEncodingFromString(arguments.encoding).value_or(WireEncoding::Json);
+  RpcResponse response;
+  response.requestId = request.id;
+  response.success = true;
+  response.returnValue = {{"encoding", WireEncodingToString(encoding)}};
+  // The response still goes out in the encoding the client used for the
+  // handshake. The send thread switches right after writing it, so every
+  // message written later uses the negotiated one, whenever it was queued.
+  OutgoingMessage message;
+  message.body = json(response);
+  message.switchEncoding = encoding;
+  outgoingMessageQueue.Push(std::move(message));
+  // Requests the client sends from now on are in the negotiated encoding.
+  wireEncoding.store(encoding);
+  SDL_Log("Negotiated %s wire encoding", WireEncodingToString(encoding));
+}
+
+void BrowserProcessHandler::Client_CreateBrowserRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser_,
+    const Client_CreateBrowser& arguments) {
+  HWND parentWindowHandle =
+      reinterpret_cast<HWND>(arguments.parentWindowHandle);
   CefWindowInfo windowInfo;
-  if (windowless) {
+  if (arguments.windowless) {
     windowInfo.SetAsWindowless(parentWindowHandle);  // no OS parent 
-    windowInfo.shared_texture_enabled = hardwareAccelerated;
+    windowInfo.shared_texture_enabled = arguments.hardwareAccelerated;
+    windowInfo.external_begin_frame_enabled =
+        arguments.externalBeginFrame.value_or(
+            CefCommandLine::GetGlobalCommandLine()->HasSwitch(
+                switches::kExternalBeginFrameEnabled));
   } else {
-    windowInfo.SetAsChild(parentWindowHandle, rectangle);
+    windowInfo.SetAsChild(parentWindowHandle, arguments.rectangle);
   }
-  windowInfo.bounds = rectangle;
+  windowInfo.bounds = arguments.rectangle;
 
   CefBrowserSettings browserSettings;
   browserSettings.windowless_frame_rate = 30;
@@ -247,380 +283,659 @@ void BrowserProcessHandler::Client_CreateBrowserRpc(const UUID& requestId,
       CefRequestContext::CreateContext(CefRequestContextSettings(), nullptr);
   CefRefPtr<CefDictionaryValue> extraInfo = CefDictionaryValue::Create();
 
-  CefRefPtr<BrowserHandler> handler = new BrowserHandler(this, rectangle);
+  CefRefPtr<BrowserHandler> handler =
+      new BrowserHandler(this, arguments.rectangle);
 
-  CefRefPtr<CefBrowser> browser = CefBrowserHost::CreateBrowserSync(
-      windowInfo, handler, url, browserSettings, extraInfo, requestContext);
+  CefRefPtr<CefBrowser> browser =
+      CefBrowserHost::CreateBrowserSync(windowInfo, handler, arguments.url,
+                                        browserSettings, extraInfo,
+                                        requestContext);
 
   int browserId = -1;
   if (browser) {
     browserId = browser->GetIdentifier();
-    browserEntries[browserId] = {handler, browser};
+    browsers.Add(browserId, handler, browser);
     SDL_Log("Created browser on UI thread; id=%d url=%s", browserId,
-            url.c_str());
+            arguments.url.c_str());
     RpcResponse response;
-    response.requestId = requestId;
+    response.requestId = request.id;
     response.success = true;
     response.returnValue = browserId;
     json j = response;
-    this->SendMessage(j.dump());
+    this->SendMessage(std::move(j));
     handler->MarkCreated();
   } else {
     SDL_Log("CreateBrowserSync returned null");
   }
 }
 
-void BrowserProcessHandler::Client_ShutdownRpc() {
+void BrowserProcessHandler::Client_ShutdownRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
   isShuttingDown = true;
-  if (browserEntries.empty()) {
+  if (browsers.GetCount() == 0) {
     SDL_Log("No browser entries during shutdown.");
     CefQuitMessageLoop();
   } else {
-    SDL_Log("%d browser entries during shutdown.", browserEntries.size());
-    for (const auto& [id, entry] : browserEntries) {
-      entry.second->GetHost()->CloseBrowser(true);
+    SDL_Log("%d browser entries during shutdown.",
+            static_cast<int>(browsers.GetCount()));
+    for (CefRefPtr<CefBrowser> entry : browsers.GetBrowsers()) {
+      entry->GetHost()->CloseBrowser(true);
+    }
+  }
+}
+
+void BrowserProcessHandler::Client_GetSchemaRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  json methods = json::array();
+  for (const RpcMethodInfo& info : kRpcMethods) {
+    json method;
+    method["id"] = static_cast<int>(info.id);
+    method["class"] = std::string(info.className);
+    method["method"] = std::string(info.methodName);
+    method["direction"] =
+        info.direction == RpcDirection::Request ? "request" : "event";
+    method["arguments"] = std::string(info.argumentsName);
+    method["thread"] = RpcThreadToString(info.thread);
+    method["priority"] = RpcPriorityToString(info.priority);
+    methods.push_back(method);
+  }
+  RpcResponse response;
+  response.requestId = request.id;
+  response.success = true;
+  response.returnValue = {{"methods", methods}};
+  json jsonResponse = response;
+  this->SendMessage(std::move(jsonResponse));
+}
+
+void BrowserProcessHandler::Client_SetResponseTimeoutsRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Client_SetResponseTimeouts& arguments) {
+  // Everything is validated before anything is applied, so a rejected call
+  // changes nothing.
+  std::vector<std::pair<size_t, uint32_t>> methodTimeouts;
+  for (const auto& [name, timeoutMs] : arguments.methodTimeoutsMs) {
+    size_t separator = name.find('.');
+    const RpcMethodInfo* info =
+        separator == std::string::npos
+            ? nullptr
+            : FindRpcMethod(std::string_view(name).substr(0, separator),
+                            std::string_view(name).substr(separator + 1));
+    if (!info) {
+      this->SendErrorResponse(request.id, "Unknown method '" + name + "'.");
+      return;
+    }
+    // Only messages the runner sends wait for a response.
+    if (info->direction != RpcDirection::Event) {
+      this->SendErrorResponse(
+          request.id, "Method '" + name + "' is not sent by the runner.");
+      return;
+    }
+    methodTimeouts.emplace_back(GetRpcMethodIndex(info->id), timeoutMs);
+  }
+  if (arguments.defaultTimeoutMs.has_value()) {
+    defaultResponseTimeoutMs.store(arguments.defaultTimeoutMs.value());
+  }
+  for (const auto& [index, timeoutMs] : methodTimeouts) {
+    responseTimeoutsMs[index].store(timeoutMs);
+  }
+  RpcResponse response;
+  response.requestId = request.id;
+  response.success = true;
+  json jsonResponse = response;
+  this->SendMessage(std::move(jsonResponse));
+}
+
+void BrowserProcessHandler::Client_GetMetricsRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  OutgoingMessageQueue::Stats outgoingStats = outgoingMessageQueue.GetStats();
+  json browserQueueDepths = json::array();
+  for (const auto& [browserId, depth] : outgoingStats.browserDepths) {
+    browserQueueDepths.push_back({{"browserId", browserId}, {"depth", depth}});
+  }
+  RpcResponse response;
+  response.requestId = request.id;
+  response.success = true;
+  response.returnValue = {
+      {"responseTimeouts", responseTimeoutCount.load()},
+      {"lateResponses", lateResponseCount.load()},
+      {"coalescedInputEvents", inputCoalescer.GetMergedCount()},
+      {"outgoingQueueDepth", outgoingStats.depth},
+      {"outgoingQueueDepthByBrowser", browserQueueDepths},
+      {"coalescedOutgoingEvents", outgoingStats.coalesced},
+      {"droppedLogMessages", outgoingStats.droppedLogs},
+      {"blockedOutgoingMessages", outgoingStats.blockedPushes},
+  };
+  json jsonResponse = response;
+  this->SendMessage(std::move(jsonResponse));
+}
+
+void BrowserProcessHandler::Client_BeginFramesRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Client_BeginFrames& arguments) {
+  for (int browserId : arguments.browserIds) {
+    CefRefPtr<CefBrowser> target = this->GetBrowser(browserId);
+    if (target) {
+      target->GetHost()->SendExternalBeginFrame();
     }
   }
 }
 
-void BrowserProcessHandler::Browser_CloseRpc(
-    const CefRefPtr<CefBrowser> browser,
-    bool forceClose) {
-  browser->GetHost()->CloseBrowser(forceClose);
+void BrowserProcessHandler::Browser_EvalJavaScriptRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+  CefRefPtr<CefProcessMessage> message =
+      CefProcessMessage::Create(kEvalMessage);
+  json jsonRequest = request;
+  message->GetArgumentList()->SetString(0, jsonRequest.dump());
+  frame->SendProcessMessage(PID_RENDERER, message);
+}
+
+void BrowserProcessHandler::Browser_ReloadRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  browser->Reload();
+}
+
+void BrowserProcessHandler::Browser_FocusRpc(const RpcRequest& request,
+                                             CefRefPtr<CefBrowser> browser,
+                                             const Browser_Focus& arguments) {
+  browser->GetHost()->SetFocus(arguments.focus);
+}
+
+void BrowserProcessHandler::Browser_WasHiddenRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_WasHidden& arguments) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->NotifyHidden(arguments.hidden);
+  }
+  browser->GetHost()->WasHidden(arguments.hidden);
+}
+
+void BrowserProcessHandler::Browser_LoadUrlRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_LoadUrl& arguments) {
+  CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+  frame->LoadURL(arguments.url);
+}
+
+void BrowserProcessHandler::Browser_LoadRequestRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_LoadRequest& arguments) {
+  CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+  CefRefPtr<CefRequest> cefRequest = CefRequest::Create();
+  cefRequest->SetURL(arguments.url);
+  cefRequest->SetMethod(arguments.method);
+  if (arguments.postData.size() > 0) {
+    CefRefPtr<CefPostData> postData = CefPostData::Create();
+    for (const auto& elementArguments : arguments.postData) {
+      CefRefPtr<CefPostDataElement> element = CefPostDataElement::Create();
+      switch (elementArguments.type) {
+        case CefPostDataElement::Type::PDE_TYPE_EMPTY:
+          element->SetToEmpty();
+          break;
+        case CefPostDataElement::Type::PDE_TYPE_FILE:
+          element->SetToFile(elementArguments.fileName.value());
+          break;
+        case CefPostDataElement::Type::PDE_TYPE_BYTES:
+          element->SetToBytes(elementArguments.bytes->size(),
+                              elementArguments.bytes->data());
+          break;
+      }
+      postData->AddElement(element);
+    }
+    cefRequest->SetPostData(postData);
+  }
+  for (const auto& [key, value] : arguments.headerMap) {
+    cefRequest->SetHeaderByName(key, value, true);
+  }
+  frame->LoadRequest(cefRequest);
+}
+
+void BrowserProcessHandler::Browser_WasResizedRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  browser->GetHost()->WasResized();
+}
+
+void BrowserProcessHandler::Browser_CutRpc(const RpcRequest& request,
+                                           CefRefPtr<CefBrowser> browser,
+                                           const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Cut();
+}
+
+void BrowserProcessHandler::Browser_CopyRpc(const RpcRequest& request,
+                                            CefRefPtr<CefBrowser> browser,
+                                            const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Copy();
+}
+
+void BrowserProcessHandler::Browser_PasteRpc(const RpcRequest& request,
+                                             CefRefPtr<CefBrowser> browser,
+                                             const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Paste();
+}
+
+void BrowserProcessHandler::Browser_DeleteRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Delete();
+}
+
+void BrowserProcessHandler::Browser_UndoRpc(const RpcRequest& request,
+                                            CefRefPtr<CefBrowser> browser,
+                                            const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Undo();
+}
+
+void BrowserProcessHandler::Browser_RedoRpc(const RpcRequest& request,
+                                            CefRefPtr<CefBrowser> browser,
+                                            const std::monostate& arguments) {
+  browser->GetFocusedFrame()->Redo();
+}
+
+void BrowserProcessHandler::Browser_SelectAllRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  browser->GetFocusedFrame()->SelectAll();
+}
+
+void BrowserProcessHandler::Browser_OnMouseClickRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_OnMouseClick& arguments) {
+  this->NotifyInput(browser);
+  browser->GetHost()->SendMouseClickEvent(
+      arguments.event,
+      static_cast<CefBrowserHost::MouseButtonType>(arguments.button),
+      arguments.mouseUp, arguments.clickCount);
+}
+
+void BrowserProcessHandler::Browser_OnMouseMoveRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_OnMouseMove& arguments) {
+  this->NotifyInput(browser);
+  browser->GetHost()->SendMouseMoveEvent(arguments.event,
+                                         arguments.mouseLeave);
+}
+
+void BrowserProcessHandler::Browser_OnMouseWheelRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_OnMouseWheel& arguments) {
+  this->NotifyInput(browser);
+  browser->GetHost()->SendMouseWheelEvent(arguments.event, arguments.deltaX,
+                                          arguments.deltaY);
+}
+
+void BrowserProcessHandler::Browser_OnKeyboardEventRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_OnKeyboardEvent& arguments) {
+  this->NotifyInput(browser);
+  browser->GetHost()->SendKeyEvent(arguments.event);
+}
+
+namespace {
+
+// Applies one entry of Browser.SendInputBatch.
+struct InputEventSender {
+  CefRefPtr<CefBrowserHost> host;
+
+  void operator()(const Browser_OnMouseClick& e) const {
+    host->SendMouseClickEvent(
+        e.event, static_cast<CefBrowserHost::MouseButtonType>(e.button),
+        e.mouseUp, e.clickCount);
+  }
+  void operator()(const Browser_OnMouseMove& e) const {
+    host->SendMouseMoveEvent(e.event, e.mouseLeave);
+  }
+  void operator()(const Browser_OnMouseWheel& e) const {
+    host->SendMouseWheelEvent(e.event, e.deltaX, e.deltaY);
+  }
+  void operator()(const Browser_OnKeyboardEvent& e) const {
+    host->SendKeyEvent(e.event);
+  }
+  void operator()(const Browser_OnTouchEvent& e) const {
+    host->SendTouchEvent(e.event);
+  }
+};
+
+}  // namespace
+
+void BrowserProcessHandler::Browser_SendInputBatchRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SendInputBatch& arguments) {
+  if (arguments.events.empty()) {
+    return;
+  }
+  this->NotifyInput(browser);
+  InputEventSender sender{browser->GetHost()};
+  for (const Browser_InputEvent& event : arguments.events) {
+    std::visit(sender, event);
+  }
+}
+
+void BrowserProcessHandler::Browser_CloseRpc(const RpcRequest& request,
+                                             CefRefPtr<CefBrowser> browser,
+                                             const Browser_Close& arguments) {
+  browser->GetHost()->CloseBrowser(arguments.forceClose);
 }
 
 void BrowserProcessHandler::Browser_TryCloseRpc(
-    const CefRefPtr<CefBrowser> browser,
-    const UUID& requestId) {
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
   bool canClose = browser->GetHost()->TryCloseBrowser();
   RpcResponse response;
-  response.requestId = requestId;
+  response.requestId = request.id;
   response.returnValue = canClose;
   json jsonResponse = response;
-  this->SendMessage(jsonResponse.dump());
+  this->SendMessage(std::move(jsonResponse));
+}
+
+void BrowserProcessHandler::Browser_DownloadImageRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_DownloadImage& arguments) {
+  CefRefPtr<DownloadImageCallback> callback =
+      new DownloadImageCallback(this, request.id, arguments.imageUrl);
+  browser->GetHost()->DownloadImage(
+      arguments.imageUrl, arguments.isFavicon,
+      static_cast<uint32_t>(arguments.maxImageSize), arguments.bypassCache,
+      callback);
+}
+
+void BrowserProcessHandler::Browser_GetSourceRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+  CefRefPtr<GetSourceStringVisitor> visitor =
+      new GetSourceStringVisitor(this, request.id);
+  frame->GetSource(visitor);
 }
 
 void BrowserProcessHandler::Browser_GetFrameRateRpc(
-    const CefRefPtr<CefBrowser> browser,
-     const UUID& requestId) {
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
   int frameRate = browser->GetHost()->GetWindowlessFrameRate();
   RpcResponse response;
-  response.requestId = requestId;
+  response.requestId = request.id;
   response.success = true;
   response.returnValue = frameRate;
   json jsonResponse = response;
-  this->SendMessage(jsonResponse.dump());
+  this->SendMessage(std::move(jsonResponse));
+}
+
+void BrowserProcessHandler::Browser_SetGeometryRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SetGeometry& arguments) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->SetGeometry(browser, arguments);
+  }
 }
 
-void BrowserProcessHandler::SendMessage(std::string payload) {
-  outgoingMessageQueue.push(payload);
+void BrowserProcessHandler::Browser_SetPaintOptionsRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SetPaintOptions& arguments) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->SetPaintOptions(arguments);
+  }
 }
 
-void BrowserProcessHandler::SendErrorResponse(const UUID& requestId,
+void BrowserProcessHandler::Browser_PaintAckRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_PaintAck& arguments) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->AcknowledgePaint(arguments);
+  }
+}
+
+void BrowserProcessHandler::Browser_SetFrameRateBoundsRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SetFrameRateBounds& arguments) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->SetFrameRateBounds(browser, arguments);
+  }
+}
+
+void BrowserProcessHandler::Browser_BeginFrameRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const std::monostate& arguments) {
+  browser->GetHost()->SendExternalBeginFrame();
+}
+
+void BrowserProcessHandler::Browser_SetFrameRateRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SetFrameRate& arguments) {
+  browser->GetHost()->SetWindowlessFrameRate(arguments.frameRate);
+}
+
+void BrowserProcessHandler::Browser_SetSendWeightRpc(
+    const RpcRequest& request,
+    CefRefPtr<CefBrowser> browser,
+    const Browser_SetSendWeight& arguments) {
+  outgoingMessageQueue.SetWeight(browser->GetIdentifier(), arguments.weight);
+}
+
+void BrowserProcessHandler::NotifyInput(CefRefPtr<CefBrowser> browser) {
+  CefRefPtr<BrowserHandler> browserHandler =
+      this->GetBrowserHandler(browser->GetIdentifier());
+  if (browserHandler) {
+    browserHandler->NotifyInput(browser);
+  }
+}
+
+WireEncoding BrowserProcessHandler::GetWireEncoding() {
+  return wireEncoding.load();
+}
+
+void BrowserProcessHandler::SendMessage(json message) {
+  outgoingMessageQueue.Push(
+      OutgoingMessage{RpcPriority::Blocking, std::move(message)});
+}
+
+bool BrowserProcessHandler::SendRequest(OutgoingRequest request) {
+  RpcPriority priority = GetRpcMethodInfo(request.method).priority;
+  return outgoingMessageQueue.Push(
+      OutgoingMessage{priority, std::move(request)});
+}
+
+bool BrowserProcessHandler::ForwardJsonMessage(ForwardedJson message) {
+  // Renderer messages are not decoded here. Those of unknown kind share the
+  // lane of the navigation events they mostly are.
+  RpcPriority priority = message.method == RpcMethodId::Unknown
+                             ? RpcPriority::State
+                             : GetRpcMethodInfo(message.method).priority;
+  return outgoingMessageQueue.Push(
+      OutgoingMessage{priority, std::move(message)});
+}
+
+void BrowserProcessHandler::SendErrorResponse(const RpcId& requestId,
                                              std::string message) {
   RpcResponse response;
   response.requestId = requestId;
   response.success = false;
   response.returnValue = message;
   json jsonResponse = response;
-  this->SendMessage(jsonResponse.dump());
+  this->SendMessage(std::move(jsonResponse));
 }
 
 void BrowserProcessHandler::SendLogMessage(const SDL_LogPriority level,
                                            const std::string& message) {
-  RpcRequest request;
-  request.id = CreateUuid();
-  request.className = "Client";
-  request.methodName = "OnLogMessage";
+  OutgoingRequest request;
+  request.id = NextRpcId();
+  request.method = RpcMethodId::Client_OnLogMessage;
   json args;
   args["level"] = level;
   args["message"] = message;
-  request.arguments = args;
-  json j = request;
-  this->SendMessage(j.dump());
+  request.arguments = std::move(args);
+  this->SendRequest(std::move(request));
   SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, level, "%s", message.c_str());
 }
 
-void BrowserProcessHandler::HandleRpcRequest(RpcRequest request) {
-  if (request.className == "Client") {
-    if (request.methodName == "CreateBrowser") {
-      Client_CreateBrowser arguments =
-          request.arguments.get<Client_CreateBrowser>();
-      HWND parentWindowHandle =
-          reinterpret_cast<HWND>(arguments.parentWindowHandle);
-      CefPostTask(
-          TID_UI,
-          base::BindOnce(&BrowserProcessHandler::Client_CreateBrowserRpc, this,
-                         request.id, arguments.url, arguments.rectangle, parentWindowHandle, arguments.windowless, arguments.hardwareAccelerated));
-      return;
-    }
+namespace {
+
+using RpcDispatcher = void (*)(BrowserProcessHandler* handler,
+                               const RpcRequest& request,
+                               CefRefPtr<CefBrowser> browser);
+
+// Decodes the arguments on the receive thread, then runs the handler inline
+// or posts it to the thread named in the registry.
+template <typename Arguments,
+          void (BrowserProcessHandler::*Handler)(const RpcRequest&,
+                                                 CefRefPtr<CefBrowser>,
+                                                 const Arguments&),
+          RpcThread Thread>
+void DispatchRpc(BrowserProcessHandler* handler,
+                 const RpcRequest& request,
+                 CefRefPtr<CefBrowser> browser) {
+  Arguments arguments = request.arguments.get<Arguments>();
+  if (Thread == RpcThread::UI) {
+    CefPostTask(TID_UI, base::BindOnce(Handler, handler, request, browser,
+                                       std::move(arguments)));
+  } else {
+    (handler->*Handler)(request, browser, arguments);
+  }
+}
 
-    if (request.methodName == "Shutdown") {
-      CefPostTask(
-          TID_UI,
-          base::BindOnce(&BrowserProcessHandler::Client_ShutdownRpc, this));
-      return;
-    }
+// Indexed like kRpcMethods; events have no dispatcher.
+const RpcDispatcher kRpcDispatchers[] = {
+#define RPC_REQUEST_DISPATCHER(id, cls, method, arguments, thread)    \
+  &DispatchRpc<arguments, &BrowserProcessHandler::cls##_##method##Rpc, \
+               RpcThread::thread>,
+#define RPC_EVENT_DISPATCHER(id, cls, method, arguments, priority) nullptr,
+    RPC_REQUESTS(RPC_REQUEST_DISPATCHER) RPC_EVENTS(RPC_EVENT_DISPATCHER)
+#undef RPC_REQUEST_DISPATCHER
+#undef RPC_EVENT_DISPATCHER
+};
+
+static_assert(sizeof(kRpcDispatchers) / sizeof(kRpcDispatchers[0]) ==
+                  kRpcMethodCount,
+              "every RPC method needs a dispatcher slot");
+
+}  // namespace
+
+void BrowserProcessHandler::HandleRpcRequest(RpcRequest request) {
+  if (request.method == RpcMethodId::Unknown) {
+    SDL_Log("HandleRpcRequest: unknown message method");
+    return;
+  }
+  const RpcMethodInfo& method = GetRpcMethodInfo(request.method);
+  RpcDispatcher dispatcher = kRpcDispatchers[GetRpcMethodIndex(request.method)];
+  if (dispatcher == nullptr) {
+    SDL_Log("HandleRpcRequest: '%s' is not a request",
+            std::string(method.methodName).c_str());
+    return;
   }
 
-  if (request.className == "Browser") {
-    CefRefPtr<BrowserHandler> browserHandler =
-        this->GetBrowserHandler(request.instanceId);
-    if (!browserHandler) {
+  CefRefPtr<CefBrowser> browser;
+  if (method.rpcClass == RpcClass::Browser) {
+    CefRefPtr<BrowserHandler> browserHandler;
+    if (!browsers.Find(request.instanceId, browserHandler, browser)) {
       std::string message = "Browser handler for browser instance " +
                             std::to_string(request.instanceId) + " not found.";
       this->SendErrorResponse(request.id, message);
       return;
     }
-    CefRefPtr<CefBrowser> browser = this->GetBrowser(request.instanceId);
     if (!browser) {
       std::string message = "Browser instance " +
                             std::to_string(request.instanceId) + " not found.";
       this->SendErrorResponse(request.id, message);
       return;
     }
+  }
 
-    if (request.methodName == "EvalJavaScript") {
-      CefRefPtr<CefFrame> frame = browser->GetMainFrame();
-      CefRefPtr<CefProcessMessage> message =
-          CefProcessMessage::Create(kEvalMessage);
-      json jsonRequest = request;
-      message->GetArgumentList()->SetString(0, jsonRequest.dump());
-      frame->SendProcessMessage(PID_RENDERER, message);
-      return;
-    };
-
-    if (request.methodName == "Reload") {
-      browser->Reload();
-      return;
-    }
-
-    if (request.methodName == "Focus") {
-      Browser_Focus arguments = request.arguments.get<Browser_Focus>();
-      browser->GetHost()->SetFocus(arguments.focus);
-      return;
-    }
-
-    if (request.methodName == "WasHidden") {
-      Browser_WasHidden arguments = request.arguments.get<Browser_WasHidden>();
-      browser->GetHost()->WasHidden(arguments.hidden);
-      return;
-    }
-
-    if (request.methodName == "LoadUrl") {
-      Browser_LoadUrl arguments = request.arguments.get<Browser_LoadUrl>();
-      CefRefPtr<CefFrame> frame = browser->GetMainFrame();
-      frame->LoadURL(arguments.url);
-      return;
-    }
-
-    if (request.methodName == "LoadRequest") {
-      Browser_LoadRequest arguments =
-          request.arguments.get<Browser_LoadRequest>();
-      CefRefPtr<CefFrame> frame = browser->GetMainFrame();
-      CefRefPtr<CefRequest> cefRequest = CefRequest::Create();
-      cefRequest->SetURL(arguments.url);
-      cefRequest->SetMethod(arguments.method);
-      if (arguments.postData.size() > 0) {
-        CefRefPtr<CefPostData> postData = CefPostData::Create();
-        for (const auto& elementArguments : arguments.postData) {
-          CefRefPtr<CefPostDataElement> element = CefPostDataElement::Create();
-          switch (elementArguments.type) {
-            case CefPostDataElement::Type::PDE_TYPE_EMPTY:
-              element->SetToEmpty();
-              break;
-            case CefPostDataElement::Type::PDE_TYPE_FILE:
-              element->SetToFile(elementArguments.fileName.value());
-              break;
-            case CefPostDataElement::Type::PDE_TYPE_BYTES:
-              element->SetToBytes(elementArguments.bytes->size(), elementArguments.bytes->data());
-              break;
-          }
-          postData->AddElement(element);
-        }
-        cefRequest->SetPostData(postData);
-      } 
-      for (const auto& [key, value] : arguments.headerMap) {
-        cefRequest->SetHeaderByName(key, value, true);
-      }
-      frame->LoadRequest(cefRequest);
-      return;
-    }
-
-    if (request.methodName == "WasResized") {
-      browser->GetHost()->WasResized();
-      return;
-    }
-
-    if (request.methodName == "Cut") {
-      browser->GetFocusedFrame()->Cut();
-      return;
-    }
-
-    if (request.methodName == "Copy") {
-      browser->GetFocusedFrame()->Copy();
-      return;
-    }
-
-    if (request.methodName == "Paste") {
-      browser->GetFocusedFrame()->Paste();
-      return;
-    }
-
-    if (request.methodName == "Delete") {
-      browser->GetFocusedFrame()->Delete();
-      return;
-    }
-
-    if (request.methodName == "Undo") {
-      browser->GetFocusedFrame()->Undo();
-      return;
-    }
-
-    if (request.methodName == "Redo") {
-      browser->GetFocusedFrame()->Redo();
-      return;
-    }
-
-    if (request.methodName == "SelectAll") {
-      browser->GetFocusedFrame()->SelectAll();
-      return;
-    }
-
-    if (request.methodName == "OnMouseClick") {
-      Browser_OnMouseClick arguments =
-          request.arguments.get<Browser_OnMouseClick>();
-      browser->GetHost()->SendMouseClickEvent(
-          arguments.event,
-          static_cast<CefBrowserHost::MouseButtonType>(arguments.button),
-          arguments.mouseUp, arguments.clickCount);
-      return;
-    }
-
-    if (request.methodName == "OnMouseMove") {
-      Browser_OnMouseMove arguments =
-          request.arguments.get<Browser_OnMouseMove>();
-      browser->GetHost()->SendMouseMoveEvent(arguments.event,
-                                             arguments.mouseLeave);
-      return;
-    }
-
-    if (request.methodName == "OnMouseWheel") {
-      Browser_OnMouseWheel arguments =
-          request.arguments.get<Browser_OnMouseWheel>();
-      browser->GetHost()->SendMouseWheelEvent(arguments.event, arguments.deltaX,
-                                              arguments.deltaY);
-      return;
-    }
-
-    if (request.methodName == "OnKeyboardEvent") {
-      Browser_OnKeyboardEvent arguments =
-          request.arguments.get<Browser_OnKeyboardEvent>();
-      browser->GetHost()->SendKeyEvent(arguments.event);
-      return;
-    }
-
-    if (request.methodName == "Close") {
-      Browser_Close arguments = request.arguments.get<Browser_Close>();
-      CefPostTask(TID_UI,
-                  base::BindOnce(&BrowserProcessHandler::Browser_CloseRpc, this,
-                                 browser, arguments.forceClose));
-      return;
-    }
-
-    if (request.methodName == "TryClose") {
-      CefPostTask(TID_UI,
-                  base::BindOnce(&BrowserProcessHandler::Browser_TryCloseRpc,
-                                 this, browser, request.id));
-      return;
-    }
-
-    if (request.methodName == "DownloadImage") {
-      Browser_DownloadImage arguments =
-          request.arguments.get<Browser_DownloadImage>();
-      CefRefPtr<DownloadImageCallback> callback =
-          new DownloadImageCallback(this, request.id, arguments.imageUrl);
-      browser->GetHost()->DownloadImage(
-          arguments.imageUrl, arguments.isFavicon,
-          static_cast<uint32_t>(arguments.maxImageSize), arguments.bypassCache,
-          callback);
-      return;
-    }
-
-    if (request.methodName == "GetSource") {
-      CefRefPtr<CefFrame> frame = browser->GetMainFrame();
-      CefRefPtr<GetSourceStringVisitor> visitor =
-          new GetSourceStringVisitor(this, request.id);
-      frame->GetSource(visitor);
-      return;
-    }
+  try {
+    dispatcher(this, request, browser);
+  } catch (const json::exception& e) {
+    std::string message = "Invalid arguments for '" +
+                          std::string(method.methodName) + "': " + e.what();
+    this->SendErrorResponse(request.id, message);
+  }
+}
 
-    if (request.methodName == "GetFrameRate") {
-      CefPostTask(TID_UI,
-                  base::BindOnce(&BrowserProcessHandler::Browser_GetFrameRateRpc,
-                                 this, browser, request.id));
-      return;
-    }
+void BrowserProcessHandler::HandleRpcResponse(RpcResponse response) {
+  PendingResponseTable::CompleteResult result = pendingResponses.Complete(
+      response.requestId.value, std::move(response.returnValue));
+  if (result == PendingResponseTable::CompleteResult::Late) {
+    lateResponseCount.fetch_add(1, std::memory_order_relaxed);
+  }
+}
 
-    if (request.methodName == "SetFrameRate") {
-        Browser_SetFrameRate arguments =
-          request.arguments.get<Browser_SetFrameRate>();
-        browser->GetHost()->SetWindowlessFrameRate(arguments.frameRate);
-        return;
-    }
+bool BrowserProcessHandler::ExpectResponse(const RpcId& requestId) {
+  if (!pendingResponses.Reserve(requestId.value)) {
+    SDL_Log("ExpectResponse: no free pending response slot");
+    return false;
   }
+  return true;
+}
 
-  SDL_Log("RpcWorkerThread: unknown message method '%s'",
-          request.methodName.c_str());
+void BrowserProcessHandler::CancelResponse(const RpcId& requestId) {
+  pendingResponses.Cancel(requestId.value);
 }
 
-void BrowserProcessHandler::HandleRpcResponse(RpcResponse response) {
-  SDL_LockMutex(this->responseMapMutex);
-  auto it = this->responseEntries.find(response.requestId);
-  if (it != this->responseEntries.end()) {
-    ResponseEntry* e = it->second.get();
-    SDL_LockMutex(e->mutex);
-    e->payload = response.returnValue.dump();
-    e->ready = true;
-    SDL_SignalCondition(e->cond);
-    SDL_UnlockMutex(e->mutex);
+DWORD BrowserProcessHandler::GetResponseTimeout(RpcMethodId method) {
+  uint32_t timeoutMs = responseTimeoutsMs[GetRpcMethodIndex(method)].load(
+      std::memory_order_relaxed);
+  if (timeoutMs == kUseDefaultResponseTimeout) {
+    timeoutMs = defaultResponseTimeoutMs.load(std::memory_order_relaxed);
   }
-  SDL_UnlockMutex(this->responseMapMutex);
+  return timeoutMs == 0 ? INFINITE : timeoutMs;
 }
 
 template <typename T>
-std::optional<T> BrowserProcessHandler::WaitForResponse(UUID requestId) {
-  std::unique_ptr<ResponseEntry> entry = std::make_unique<ResponseEntry>();
-
-  // Insert into map under map mutex
-  SDL_LockMutex(responseMapMutex);
-  responseEntries[requestId] = std::move(entry);
-  ResponseEntry* e = responseEntries[requestId].get();
-  SDL_UnlockMutex(responseMapMutex);
-
-  // Wait for signal
-  SDL_LockMutex(e->mutex);
-  while (!e->ready) {
-    SDL_WaitCondition(e->cond, e->mutex);
-  }
-  SDL_UnlockMutex(e->mutex);
-
-  std::string payload;
-  SDL_LockMutex(responseMapMutex);
-  auto it = responseEntries.find(requestId);
-  if (it != responseEntries.end()) {
-    ResponseEntry* entryPtr = it->second.get();
-    SDL_LockMutex(entryPtr->mutex);
-    payload = std::move(entryPtr->payload);
-    SDL_UnlockMutex(entryPtr->mutex);
-    responseEntries.erase(it);
-  }
-  SDL_UnlockMutex(responseMapMutex);
-
+std::optional<T> BrowserProcessHandler::WaitForResponse(
+    RpcMethodId method,
+    const RpcId& requestId) {
+  std::optional<json> returnValue =
+      pendingResponses.Wait(requestId.value, GetResponseTimeout(method));
+  if (!returnValue.has_value()) {
+    responseTimeoutCount.fetch_add(1, std::memory_order_relaxed);
+    SDL_Log("WaitForResponse: timed out waiting for %s response",
+            std::string(GetRpcMethodInfo(method).methodName).c_str());
+    return std::nullopt;
+  }
   try {
-    json j = json::parse(payload);
-    return j.get<T>();
+    return returnValue->get<T>();
   } catch (const std::exception& e) {
+    std::string payload = returnValue->dump();
     size_t previewLen = std::min<size_t>(payload.size(), 256);
     std::string preview = payload.substr(0, previewLen);
     std::string msg = std::string("WaitForResponse: ") + e.what() +
@@ -637,46 +952,43 @@ int BrowserProcessHandler::RpcReceiveThread(void* browserProcessHandlerPtr) {
 
   SDL_Log("Receive thread running");
 
-  std::vector<uint8_t> recvBuffer;
-  uint8_t temp[1024];
+  ReceiveBuffer recvBuffer(kReceiveBufferInitialSize, kMaxRpcFrameSize);
+  auto dispatch = [&handler](RpcRequest&& request) {
+    handler->HandleRpcRequest(std::move(request));
+  };
 
   while (true) {
-    // Block until the client sends data.
-    void* waitSockets[] = {static_cast<void*>(handler->streamSocket)};
-    NET_WaitUntilInputAvailable(waitSockets, 1, -1);
-
+    size_t available = 0;
+    uint8_t* writePtr = recvBuffer.PrepareWrite(kReceiveReadSize, available);
     int received =
-        NET_ReadFromStreamSocket(handler->streamSocket, temp, sizeof(temp));
+        handler->transport->Read(writePtr, static_cast<int>(available));
     if (received > 0) {
-      recvBuffer.insert(recvBuffer.end(), temp, temp + received);
+      recvBuffer.CommitWrite(received);
     } else if (received < 0) {
-      SDL_Log("Read error: %s", SDL_GetError());
       break;
     }
 
     // Process as many full framed messages as available.
-    while (recvBuffer.size() >= 4) {
-      uint32_t msgLen;
-      memcpy(&msgLen, recvBuffer.data(), 4);
-
-      if (recvBuffer.size() < 4 + msgLen)
-        break;
-
-      std::string jsonMsg(recvBuffer.begin() + 4,
-                          recvBuffer.begin() + 4 + msgLen);
-      recvBuffer.erase(recvBuffer.begin(), recvBuffer.begin() + 4 + msgLen);
-
+    const uint8_t* frame = nullptr;
+    uint32_t frameSize = 0;
+    ReceiveBuffer::FrameStatus status;
+    while ((status = recvBuffer.NextFrame(frame, frameSize)) ==
+           ReceiveBuffer::FrameStatus::Ready) {
+      WireEncoding encoding = handler->wireEncoding.load();
       json jsonMessage;
       try {
-        jsonMessage = json::parse(jsonMsg);
+        jsonMessage = DecodeMessage(frame, frameSize, encoding);
       } catch (const nlohmann::json::parse_error& e_parse) {
-        size_t previewLen = std::min<size_t>(jsonMsg.size(), 256);
-        std::string preview = jsonMsg.substr(0, previewLen);
+        size_t previewLen = std::min<size_t>(frameSize, 256);
+        std::string preview =
+            encoding == WireEncoding::Json
+                ? std::string(reinterpret_cast<const char*>(frame), previewLen)
+                : std::string("<binary>");
         SDL_Log(
-            "RpcReceiveThread: JSON parse_error: %s at byte=%u "
+            "RpcReceiveThread: %s parse_error: %s at byte=%u "
             "payload_preview='%s'",
-            e_parse.what(), static_cast<unsigned int>(e_parse.byte),
-            preview.c_str());
+            WireEncodingToString(encoding), e_parse.what(),
+            static_cast<unsigned int>(e_parse.byte), preview.c_str());
         continue;
       } catch (const std::exception& e) {
         SDL_Log("RpcReceiveThread: JSON exception: %s", e.what());
@@ -684,11 +996,27 @@ int BrowserProcessHandler::RpcReceiveThread(void* browserProcessHandlerPtr) {
       }
 
       if (!jsonMessage.contains("requestId")) {
-        handler->HandleRpcRequest(jsonMessage.get<RpcRequest>());
+        RpcRequest request = jsonMessage.get<RpcRequest>();
+        if (request.method == RpcMethodId::Unknown) {
+          SDL_Log("RpcReceiveThread: unknown message method '%s.%s'",
+                  jsonMessage.value("class", std::string()).c_str(),
+                  jsonMessage.value("method", std::string()).c_str());
+          continue;
+        }
+        handler->inputCoalescer.Add(std::move(request), dispatch);
       } else {
         handler->HandleRpcResponse(jsonMessage.get<RpcResponse>());
       }
     }
+
+    // Nothing else is queued; send held input before blocking in Read.
+    handler->inputCoalescer.Flush(dispatch);
+
+    if (status == ReceiveBuffer::FrameStatus::TooLarge) {
+      SDL_Log("RpcReceiveThread: frame exceeds %u byte limit, closing",
+              kMaxRpcFrameSize);
+      break;
+    }
   }
   return 0;
 }
@@ -700,39 +1028,62 @@ int BrowserProcessHandler::RpcSendThread(void* browserProcessHandlerPtr) {
 
   SDL_Log("Send thread running");
 
+  std::vector<OutgoingMessage> batch;
+  std::vector<uint8_t> sendBuf;
+  // Changes only after writing a handshake response, see OutgoingMessage.
+  WireEncoding encoding = WireEncoding::Json;
+
   while (true) {
-    // Block until an outgoing message is available.
-    std::string outMsg = handler->outgoingMessageQueue.pop();
-
-    uint32_t len = static_cast<uint32_t>(outMsg.size());
-    std::vector<uint8_t> sendBuf;
-    sendBuf.resize(4 + outMsg.size());
-    memcpy(sendBuf.data(), &len, 4);
-    if (!outMsg.empty()) {
-      memcpy(sendBuf.data() + 4, outMsg.data(), outMsg.size());
+    // Block until an outgoing message is available, then take the next
+    // batch across the priority lanes so it goes out in a single write.
+    handler->outgoingMessageQueue.PopBatch(batch);
+
+    sendBuf.clear();
+    for (OutgoingMessage& message : batch) {
+      std::string outMsg;
+      try {
+        outMsg = EncodeOutgoingMessage(message, encoding);
+      } catch (const std::exception& e) {
+        SDL_Log("RpcSendThread: dropping message: %s", e.what());
+        continue;
+      }
+      if (message.switchEncoding.has_value()) {
+        encoding = *message.switchEncoding;
+      }
+      uint32_t len = static_cast<uint32_t>(outMsg.size());
+      size_t offset = sendBuf.size();
+      sendBuf.resize(offset + 4 + outMsg.size());
+      memcpy(sendBuf.data() + offset, &len, 4);
+      if (!outMsg.empty()) {
+        memcpy(sendBuf.data() + offset + 4, outMsg.data(), outMsg.size());
+      }
     }
+    batch.clear();
 
     int total = static_cast<int>(sendBuf.size());
-    if (!NET_WriteToStreamSocket(handler->streamSocket, sendBuf.data(),
-                                 total)) {
-      SDL_Log("NET_WriteToStreamSocket failed or connection closed: %s",
-              SDL_GetError());
+    if (!handler->transport->Write(sendBuf.data(), total)) {
       break;
     }
-    NET_WaitUntilStreamSocketDrained(handler->streamSocket, -1);
+    handler->transport->Flush();
     PostMessageW(handler->applicationMessageWindowHandle,
                  handler->windowMessageId, 0, 0);
   }
+  // Nothing will drain the queue any more; do not leave producers waiting
+  // for room.
+  handler->outgoingMessageQueue.Close();
   return 0;
 }
 
 template std::optional<std::monostate>
-    BrowserProcessHandler::WaitForResponse<std::monostate>(UUID);
+    BrowserProcessHandler::WaitForResponse<std::monostate>(RpcMethodId,
+                                                           const RpcId&);
 template std::optional<bool>
-    BrowserProcessHandler::WaitForResponse<bool>(UUID);
+    BrowserProcessHandler::WaitForResponse<bool>(RpcMethodId, const RpcId&);
 template std::optional<CefRect>
-    BrowserProcessHandler::WaitForResponse<CefRect>(UUID);
+    BrowserProcessHandler::WaitForResponse<CefRect>(RpcMethodId, const RpcId&);
 template std::optional<ContextMenuConfiguration>
-    BrowserProcessHandler::WaitForResponse<ContextMenuConfiguration>(UUID);
+    BrowserProcessHandler::WaitForResponse<ContextMenuConfiguration>(
+        RpcMethodId,
+        const RpcId&);
 template std::optional<CefPoint>
-    BrowserProcessHandler::WaitForResponse<CefPoint>(UUID);
\ No newline at end of file
+    BrowserProcessHandler::WaitForResponse<CefPoint>(RpcMethodId, const RpcId&);
\ No newline at end of file
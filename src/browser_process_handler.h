@@ -1,48 +1,72 @@
 #pragma once
 
 #include <rpc.h>
-#include "SDL3_net/SDL_net.h"
+#include <array>
+#include <atomic>
+#include <memory>
 #include "include/cef_base.h"
+#include "browser_registry.h"
+#include "input_coalescer.hpp"
+#include "outgoing_message.hpp"
+#include "outgoing_message_queue.h"
+#include "pending_response_table.hpp"
 #include "process_handler.h"
 #include "rpc.hpp"
-#include "thread_safe_queue.hpp"
+#include "rpc_transport.h"
+#include "wire_encoding.hpp"
 
 class BrowserHandler;
 
 class BrowserProcessHandler : public ProcessHandler, public CefBrowserProcessHandler {
 public:
- BrowserProcessHandler(HANDLE applicationProcessHandle, HWND applicationMessageWindowHandle, int windowMessageId);
+ BrowserProcessHandler(HANDLE applicationProcessHandle, HWND applicationMessageWindowHandle, int windowMessageId, std::unique_ptr<RpcTransport> transport);
  ~BrowserProcessHandler();
 
  // Accessors.
- NET_Server* GetSocketServer();
+ RpcTransport* GetTransport();
  CefRefPtr<CefBrowser> GetBrowser(int browserId);
  CefRefPtr<BrowserHandler> GetBrowserHandler(int browserId);
  void RemoveBrowserHandler(int browserId);
  HANDLE GetApplicationProcessHandle();
  HWND GetApplicationMessageWindowHandle();
  int GetWindowMessageId();
+ WireEncoding GetWireEncoding();
 
   // CefBrowserProcessHandler methods.
   CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler() override;
+  void OnBeforeChildProcessLaunch(
+      CefRefPtr<CefCommandLine> command_line) override;
   void OnContextInitialized() override;
   
   // RPC handling.
   void HandleRpcRequest(RpcRequest request);
   void HandleRpcResponse(RpcResponse response);
 
-  // Incoming RPC messages.
-  void Client_CreateBrowserRpc(const UUID& requestId, const CefString& url, const CefRect& rectangle, HWND parentWindowHandle, bool windowless, bool hardwareAccelerated);
-  void Client_ShutdownRpc();
-  void Browser_CloseRpc(const CefRefPtr<CefBrowser> browser, bool forceClose);
-  void Browser_TryCloseRpc(const CefRefPtr<CefBrowser> browser, const UUID& requestId);
-  void Browser_GetFrameRateRpc(const CefRefPtr<CefBrowser> browser, const UUID& requestId);
-  
-  // Outgoing RPC messages.
-  void SendMessage(std::string payload);
-  void SendErrorResponse(const UUID& requestId, std::string message);
+  // Incoming RPC messages, one handler per request in rpc_methods.hpp.
+  // |browser| is null for Client requests.
+#define RPC_REQUEST_HANDLER(id, cls, method, arguments, thread)           \
+  void cls##_##method##Rpc(const RpcRequest& request,                     \
+                           CefRefPtr<CefBrowser> browser,                 \
+                           const arguments& arguments);
+  RPC_REQUESTS(RPC_REQUEST_HANDLER)
+#undef RPC_REQUEST_HANDLER
+
+  // Outgoing RPC messages. They are encoded on the send thread. Requests and
+  // forwarded messages wait for room in the queue; these return false if the
+  // message was dropped, see OutgoingMessageQueue::Push.
+  void SendMessage(json message);
+  bool SendRequest(OutgoingRequest request);
+  bool ForwardJsonMessage(ForwardedJson message);
+  void SendErrorResponse(const RpcId& requestId, std::string message);
   void SendLogMessage(const SDL_LogPriority level, const std::string& message);
-  template<typename T> std::optional<T> WaitForResponse(UUID id);
+
+  // Synchronous round trips: reserve a slot for the response before sending
+  // the request, then block on it.
+  bool ExpectResponse(const RpcId& requestId);
+  void CancelResponse(const RpcId& requestId);
+  // Returns nullopt if the client does not respond within the method's
+  // deadline; callers fall back to a default.
+  template<typename T> std::optional<T> WaitForResponse(RpcMethodId method, const RpcId& requestId);
   
   // RPC threads, need to be static.
   static int RpcReceiveThread(void* browserProcessHandlerPtr);
@@ -53,14 +77,28 @@ public:
   HWND applicationWindowHandle;
   HWND applicationMessageWindowHandle;
   int windowMessageId;
-  ThreadSafeQueue<std::string> outgoingMessageQueue;
-  SDL_Mutex* responseMapMutex = nullptr;
-  std::map<UUID, std::unique_ptr<ResponseEntry>> responseEntries;
-  std::map<int, std::pair<CefRefPtr<BrowserHandler>, CefRefPtr<CefBrowser>>> browserEntries;
+  OutgoingMessageQueue outgoingMessageQueue;
+  std::atomic<WireEncoding> wireEncoding;
+  PendingResponseTable pendingResponses;
+  // Receive thread only.
+  InputCoalescer inputCoalescer;
+  // Looked up from any thread, changed on the UI thread.
+  BrowserRegistry browsers;
   bool isShuttingDown;
+  // Request id prefixes handed to child processes, in launch order.
+  std::atomic<uint32_t> nextRpcIdPrefix;
+
+  std::unique_ptr<RpcTransport> transport;
+
+  // Feeds input received on the receive thread to the frame rate governor.
+  void NotifyInput(CefRefPtr<CefBrowser> browser);
 
-  NET_Server* socketServer;
-  NET_StreamSocket* streamSocket;
+  // Response deadlines, per method in kRpcMethods order.
+  DWORD GetResponseTimeout(RpcMethodId method);
+  std::atomic<uint32_t> defaultResponseTimeoutMs;
+  std::array<std::atomic<uint32_t>, kRpcMethodCount> responseTimeoutsMs;
+  std::atomic<uint64_t> responseTimeoutCount;
+  std::atomic<uint64_t> lateResponseCount;
 
   IMPLEMENT_REFCOUNTING(BrowserProcessHandler);
   DISALLOW_COPY_AND_ASSIGN(BrowserProcessHandler);
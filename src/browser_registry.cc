@@ -0,0 +1,242 @@
+#include "browser_registry.h"
+
+#include <memory>
+
+#include "browser_handler.h"
+
+namespace {
+
+const size_t kInitialCapacity = 64;
+
+}  // namespace
+
+struct BrowserRegistry::Entry {
+  int browserId = 0;
+  CefRefPtr<BrowserHandler> handler;
+  CefRefPtr<CefBrowser> browser;
+};
+
+struct BrowserRegistry::Table {
+  explicit Table(size_t capacity)
+      : mask(capacity - 1), slots(new std::atomic<Entry*>[capacity]) {
+    for (size_t i = 0; i < capacity; ++i) {
+      slots[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  size_t GetCapacity() const { return mask + 1; }
+
+  size_t mask;
+  std::unique_ptr<std::atomic<Entry*>[]> slots;
+};
+
+// Counts the calling thread into the current epoch. Rechecks the epoch after
+// counting in, so the UI thread either sees the count or the reader sees the
+// newer epoch.
+class BrowserRegistry::ReadGuard {
+ public:
+  explicit ReadGuard(BrowserRegistry& registry) {
+    while (true) {
+      uint64_t current = registry.epoch.load();
+      counter = &registry.readers[current & 1];
+      counter->fetch_add(1);
+      if (registry.epoch.load() == current) {
+        break;
+      }
+      counter->fetch_sub(1);
+    }
+  }
+
+  ~ReadGuard() { counter->fetch_sub(1, std::memory_order_release); }
+
+ private:
+  std::atomic<uint64_t>* counter;
+};
+
+BrowserRegistry::BrowserRegistry()
+    : table(new Table(kInitialCapacity)),
+      epoch(2),
+      liveCount(0),
+      usedSlots(0) {
+  for (std::atomic<uint64_t>& count : readers) {
+    count.store(0);
+  }
+}
+
+BrowserRegistry::~BrowserRegistry() {
+  Table* current = table.load();
+  for (size_t i = 0; i < current->GetCapacity(); ++i) {
+    Entry* entry = current->slots[i].load();
+    if (entry && entry != Tombstone()) {
+      delete entry;
+    }
+  }
+  delete current;
+  for (const Retired& item : retired) {
+    delete item.entry;
+    delete item.table;
+  }
+}
+
+bool BrowserRegistry::Find(int browserId,
+                           CefRefPtr<BrowserHandler>& handler,
+                           CefRefPtr<CefBrowser>& browser) {
+  ReadGuard guard(*this);
+  const Entry* entry = FindEntry(browserId);
+  if (!entry) {
+    return false;
+  }
+  handler = entry->handler;
+  browser = entry->browser;
+  return true;
+}
+
+CefRefPtr<BrowserHandler> BrowserRegistry::GetHandler(int browserId) {
+  ReadGuard guard(*this);
+  const Entry* entry = FindEntry(browserId);
+  return entry ? entry->handler : nullptr;
+}
+
+CefRefPtr<CefBrowser> BrowserRegistry::GetBrowser(int browserId) {
+  ReadGuard guard(*this);
+  const Entry* entry = FindEntry(browserId);
+  return entry ? entry->browser : nullptr;
+}
+
+void BrowserRegistry::Add(int browserId,
+                          CefRefPtr<BrowserHandler> handler,
+                          CefRefPtr<CefBrowser> browser) {
+  Remove(browserId);
+  Table* current = table.load(std::memory_order_relaxed);
+  // Keep at least a quarter of the slots empty so probes stay short and
+  // always end.
+  if ((usedSlots + 1) * 4 > current->GetCapacity() * 3) {
+    size_t capacity = current->GetCapacity();
+    while ((liveCount + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+    Rebuild(capacity);
+    current = table.load(std::memory_order_relaxed);
+  }
+
+  Entry* entry = new Entry;
+  entry->browserId = browserId;
+  entry->handler = handler;
+  entry->browser = browser;
+  size_t i = static_cast<uint32_t>(browserId) & current->mask;
+  while (true) {
+    Entry* slot = current->slots[i].load(std::memory_order_relaxed);
+    if (!slot || slot == Tombstone()) {
+      if (!slot) {
+        usedSlots++;
+      }
+      current->slots[i].store(entry, std::memory_order_release);
+      break;
+    }
+    i = (i + 1) & current->mask;
+  }
+  liveCount++;
+  Reclaim();
+}
+
+void BrowserRegistry::Remove(int browserId) {
+  Table* current = table.load(std::memory_order_relaxed);
+  size_t i = static_cast<uint32_t>(browserId) & current->mask;
+  while (true) {
+    Entry* slot = current->slots[i].load(std::memory_order_relaxed);
+    if (!slot) {
+      return;
+    }
+    if (slot != Tombstone() && slot->browserId == browserId) {
+      // The tombstone keeps probes for entries further along going.
+      current->slots[i].store(Tombstone(), std::memory_order_release);
+      liveCount--;
+      Retire(slot, nullptr);
+      Reclaim();
+      return;
+    }
+    i = (i + 1) & current->mask;
+  }
+}
+
+size_t BrowserRegistry::GetCount() const {
+  return liveCount;
+}
+
+std::vector<CefRefPtr<CefBrowser>> BrowserRegistry::GetBrowsers() const {
+  std::vector<CefRefPtr<CefBrowser>> browsers;
+  Table* current = table.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < current->GetCapacity(); ++i) {
+    Entry* entry = current->slots[i].load(std::memory_order_relaxed);
+    if (entry && entry != Tombstone()) {
+      browsers.push_back(entry->browser);
+    }
+  }
+  return browsers;
+}
+
+BrowserRegistry::Entry* BrowserRegistry::Tombstone() {
+  static Entry tombstone;
+  return &tombstone;
+}
+
+const BrowserRegistry::Entry* BrowserRegistry::FindEntry(int browserId) const {
+  const Table* current = table.load(std::memory_order_acquire);
+  size_t i = static_cast<uint32_t>(browserId) & current->mask;
+  while (true) {
+    const Entry* entry = current->slots[i].load(std::memory_order_acquire);
+    if (!entry) {
+      return nullptr;
+    }
+    if (entry != Tombstone() && entry->browserId == browserId) {
+      return entry;
+    }
+    i = (i + 1) & current->mask;
+  }
+}
+
+void BrowserRegistry::Rebuild(size_t capacity) {
+  Table* previous = table.load(std::memory_order_relaxed);
+  Table* next = new Table(capacity);
+  for (size_t i = 0; i < previous->GetCapacity(); ++i) {
+    Entry* entry = previous->slots[i].load(std::memory_order_relaxed);
+    if (!entry || entry == Tombstone()) {
+      continue;
+    }
+    size_t j = static_cast<uint32_t>(entry->browserId) & next->mask;
+    while (next->slots[j].load(std::memory_order_relaxed)) {
+      j = (j + 1) & next->mask;
+    }
+    next->slots[j].store(entry, std::memory_order_relaxed);
+  }
+  usedSlots = liveCount;
+  // Entries move over as they are; only the old slot array is retired.
+  table.store(next, std::memory_order_release);
+  Retire(nullptr, previous);
+}
+
+void BrowserRegistry::Retire(Entry* entry, Table* oldTable) {
+  retired.push_back({epoch.load(), entry, oldTable});
+}
+
+void BrowserRegistry::Reclaim() {
+  uint64_t current = epoch.load();
+  // Readers of the previous epoch share the counter of the next one. Two
+  // steps free what was just retired right away when nobody is reading.
+  for (int step = 0; step < 2; ++step) {
+    if (readers[(current + 1) & 1].load() != 0) {
+      break;
+    }
+    epoch.store(++current);
+  }
+  size_t kept = 0;
+  for (const Retired& item : retired) {
+    if (item.epoch + 2 <= current) {
+      delete item.entry;
+      delete item.table;
+    } else {
+      retired[kept++] = item;
+    }
+  }
+  retired.resize(kept);
+}
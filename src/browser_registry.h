@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "include/cef_browser.h"
+
+class BrowserHandler;
+
+// Browsers by id, looked up for every RPC request.
+//
+// Lookups may run on any thread and take no lock. Entries live in an open
+// addressing table indexed by browser id; CEF hands out ids sequentially,
+// so the id is its own hash and lookups rarely probe. Only the UI thread
+// adds and removes browsers. It never changes an entry or table in place
+// that a reader might be looking at: it publishes a new one and retires
+// the old one.
+//
+// Retired objects are freed by epoch based reclamation. A reader counts
+// itself into the current epoch for the duration of a lookup, and copies
+// the references it needs before leaving, so a handler stays alive for as
+// long as its caller holds it even if the browser is removed meanwhile. The
+// UI thread only advances the epoch once no reader is left in the epoch
+// before the current one. It frees an object retired in epoch e once the
+// epoch has reached e + 2, because no reader can still hold it then.
+class BrowserRegistry {
+ public:
+  BrowserRegistry();
+  ~BrowserRegistry();
+
+  // Any thread. Returns false if there is no such browser.
+  bool Find(int browserId,
+            CefRefPtr<BrowserHandler>& handler,
+            CefRefPtr<CefBrowser>& browser);
+  CefRefPtr<BrowserHandler> GetHandler(int browserId);
+  CefRefPtr<CefBrowser> GetBrowser(int browserId);
+
+  // UI thread only.
+  void Add(int browserId,
+           CefRefPtr<BrowserHandler> handler,
+           CefRefPtr<CefBrowser> browser);
+  void Remove(int browserId);
+  size_t GetCount() const;
+  std::vector<CefRefPtr<CefBrowser>> GetBrowsers() const;
+
+ private:
+  struct Entry;
+  struct Table;
+  class ReadGuard;
+
+  struct Retired {
+    uint64_t epoch;
+    Entry* entry;
+    Table* table;
+  };
+
+  static Entry* Tombstone();
+
+  const Entry* FindEntry(int browserId) const;
+  // Publishes a table of |capacity| slots holding the live entries.
+  void Rebuild(size_t capacity);
+  void Retire(Entry* entry, Table* table);
+  void Reclaim();
+
+  std::atomic<Table*> table;
+  // Readers in epochs of even and odd parity.
+  std::array<std::atomic<uint64_t>, 2> readers;
+  std::atomic<uint64_t> epoch;
+
+  // UI thread only.
+  size_t liveCount;
+  // Live entries plus tombstones.
+  size_t usedSlots;
+  std::vector<Retired> retired;
+};
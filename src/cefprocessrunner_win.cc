@@ -3,8 +3,10 @@
 // can be found in the LICENSE file.
 
 #include <windows.h>
+#include <cstdlib>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <optional>
 #include <string>
 
@@ -16,6 +18,9 @@
 #include "other_process_handler.h"
 #include "process_handler.h"
 #include "render_process_handler.h"
+#include "rpc_id.hpp"
+#include "shared_memory_transport.h"
+#include "socket_transport.h"
 
 // When generating projects with CMake the CEF_USE_SANDBOX value will be defined
 // automatically if using the required compiler version. Pass -DUSE_SANDBOX=OFF
@@ -82,6 +87,27 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
   ProcessHandler::ProcessType process_type =
       ProcessHandler::GetProcessType(command_line);
 
+  // Request ids are plain integers unless the client still expects UUIDs.
+  // The browser process forwards the switch to renderers, along with a
+  // prefix that keeps each renderer's ids apart.
+  uint32_t rpc_id_prefix = 0;
+  if (process_type == ProcessHandler::RendererProcess) {
+    const std::string& rpc_id_prefix_str =
+        command_line->GetSwitchValue(switches::kRpcIdPrefix);
+    char* end = nullptr;
+    unsigned long prefix = strtoul(rpc_id_prefix_str.c_str(), &end, 10);
+    if (rpc_id_prefix_str.empty() || *end != '\0' || prefix == 0 ||
+        prefix > kMaxRpcIdPrefix) {
+      SDL_Log("ERROR: missing or invalid --rpc-id-prefix");
+      return 1;
+    }
+    rpc_id_prefix = static_cast<uint32_t>(prefix);
+  }
+  InitializeRpcIds(command_line->HasSwitch(switches::kRpcUuidRequestIds)
+                       ? RpcIdFormat::Uuid
+                       : RpcIdFormat::Integer,
+                   rpc_id_prefix);
+
   SDL_Log((std::string("Running process type: ") +
            ProcessHandler::ProcessTypeToString(process_type) + "\n")
               .c_str());
@@ -109,7 +135,8 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 
     int applicationProcessId = std::stoi(application_process_id_str);
     HANDLE applicationProcessHandle =
-        OpenProcess(PROCESS_DUP_HANDLE, FALSE, applicationProcessId);
+        OpenProcess(PROCESS_DUP_HANDLE | SYNCHRONIZE, FALSE,
+                    applicationProcessId);
     if (applicationProcessHandle == NULL) {
       SDL_Log("ERROR: OpenProcess failed for process id %s",
               application_process_id_str.c_str());
@@ -121,9 +148,47 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 
     int windowMessageId = std::stoi(window_message_id_str);
 
-    handler = new BrowserProcessHandler(applicationProcessHandle,
-                                        applicationMessageWindowHandle,
-                                        windowMessageId);
+    // RPC transport: localhost TCP by default, or shared memory rings when
+    // the client runs with --rpc-transport=shared-memory.
+    std::unique_ptr<RpcTransport> transport;
+    const std::string& transport_str =
+        command_line->GetSwitchValue(switches::kRpcTransport);
+    if (transport_str.empty() || transport_str == "socket") {
+      transport = std::make_unique<SocketTransport>(3000);
+    } else if (transport_str == "shared-memory") {
+      const std::wstring& shared_memory_name =
+          command_line->GetSwitchValue(switches::kRpcSharedMemoryName);
+      if (shared_memory_name.empty()) {
+        SDL_Log("ERROR: --rpc-shared-memory-name is required");
+        return 1;
+      }
+      uint32_t ring_capacity = 4 * 1024 * 1024;
+      const std::string& shared_memory_size_str =
+          command_line->GetSwitchValue(switches::kRpcSharedMemorySize);
+      if (!shared_memory_size_str.empty()) {
+        char* end = nullptr;
+        unsigned long long size =
+            strtoull(shared_memory_size_str.c_str(), &end, 10);
+        if (*end != '\0' || size < SharedMemoryTransport::kMinRingCapacity ||
+            size > SharedMemoryTransport::kMaxRingCapacity) {
+          SDL_Log("ERROR: --rpc-shared-memory-size must be between %u and %u",
+                  SharedMemoryTransport::kMinRingCapacity,
+                  SharedMemoryTransport::kMaxRingCapacity);
+          return 1;
+        }
+        ring_capacity = static_cast<uint32_t>(size);
+      }
+      transport = std::make_unique<SharedMemoryTransport>(
+          shared_memory_name, ring_capacity, applicationProcessHandle);
+    } else {
+      SDL_Log("ERROR: unknown --rpc-transport value %s",
+              transport_str.c_str());
+      return 1;
+    }
+
+    handler = new BrowserProcessHandler(
+        applicationProcessHandle, applicationMessageWindowHandle,
+        windowMessageId, std::move(transport));
   } else if (process_type == ProcessHandler::RendererProcess) {
     handler = new RenderProcessHandler();
   } else if (process_type == ProcessHandler::OtherProcess) {
@@ -60,5 +60,10 @@ const char kApplicationProcessId[] = "application-process-id";
 const char kApplicationMessageWindowHandle[] =
     "application-message-window-handle";
 const char kWindowMessageId[] = "window-message-id";
+const char kRpcTransport[] = "rpc-transport";
+const char kRpcSharedMemoryName[] = "rpc-shared-memory-name";
+const char kRpcSharedMemorySize[] = "rpc-shared-memory-size";
+const char kRpcUuidRequestIds[] = "rpc-uuid-request-ids";
+const char kRpcIdPrefix[] = "rpc-id-prefix";
 
 }  // namespace switches
@@ -51,5 +51,10 @@ extern const char kHideChromeBubbles[];
 extern const char kApplicationProcessId[];
 extern const char kApplicationMessageWindowHandle[];
 extern const char kWindowMessageId[];
+extern const char kRpcTransport[];
+extern const char kRpcSharedMemoryName[];
+extern const char kRpcSharedMemorySize[];
+extern const char kRpcUuidRequestIds[];
+extern const char kRpcIdPrefix[];
 
 }  // namespace switches
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "frame_rate_governor.h"
+
+#include <algorithm>
+
+void FrameRateGovernor::Enable(int newMinFrameRate, int newMaxFrameRate) {
+  minFrameRate = std::max(1, newMinFrameRate);
+  maxFrameRate = std::max(minFrameRate, newMaxFrameRate);
+  enabled.store(true, std::memory_order_relaxed);
+  ceiling = maxFrameRate;
+  lastDamageTick = GetTickCount64();
+  undamagedFrames = 0;
+  framesBehind = 0;
+}
+
+void FrameRateGovernor::Disable() {
+  enabled.store(false, std::memory_order_relaxed);
+}
+
+bool FrameRateGovernor::NotifyInput() {
+  ULONGLONG now = GetTickCount64();
+  ULONGLONG previous = lastInputTick.exchange(now, std::memory_order_relaxed);
+  return IsEnabled() && now - previous >= kActiveWindowMs;
+}
+
+void FrameRateGovernor::NotifyHidden(bool isHidden) {
+  hidden.store(isHidden, std::memory_order_relaxed);
+}
+
+bool FrameRateGovernor::NotifyFrame(bool damaged, bool clientBehind) {
+  if (clientBehind) {
+    framesBehind++;
+  }
+  if (!damaged) {
+    undamagedFrames++;
+    return false;
+  }
+  ULONGLONG now = GetTickCount64();
+  bool wasIdle = undamagedFrames >= kIdleFrameCount ||
+                 now - lastDamageTick >= kActiveWindowMs;
+  lastDamageTick = now;
+  undamagedFrames = 0;
+  return IsEnabled() && wasIdle;
+}
+
+std::optional<int> FrameRateGovernor::Evaluate(int currentFrameRate) {
+  if (!IsEnabled()) {
+    return std::nullopt;
+  }
+  ULONGLONG now = GetTickCount64();
+  int behind = framesBehind;
+  framesBehind = 0;
+
+  // A lagging client lowers the ceiling, which then recovers slowly so the
+  // rate does not oscillate around what the client can take.
+  if (behind > 0) {
+    ceiling = std::max(minFrameRate, currentFrameRate * 3 / 4);
+  } else {
+    ceiling = std::min(maxFrameRate, ceiling + std::max(1, ceiling / 8));
+  }
+
+  int target;
+  if (hidden.load(std::memory_order_relaxed)) {
+    target = minFrameRate;
+  } else if (now - lastInputTick.load(std::memory_order_relaxed) <
+             kActiveWindowMs) {
+    target = maxFrameRate;
+    ceiling = maxFrameRate;
+  } else if (undamagedFrames >= kIdleFrameCount ||
+             now - lastDamageTick >= kActiveWindowMs) {
+    target = currentFrameRate / 2;
+  } else {
+    target = ceiling;
+  }
+  target = std::clamp(target, minFrameRate, maxFrameRate);
+  if (target == currentFrameRate) {
+    return std::nullopt;
+  }
+  return target;
+}
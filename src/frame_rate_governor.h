@@ -0,0 +1,49 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <optional>
+
+// Picks a windowless frame rate for one browser within client-set bounds.
+//
+// Hidden browsers run at the minimum. Browsers that have painted nothing for
+// a while step down towards the minimum, and so do browsers whose client is
+// not keeping up with the frames it is sent. Input or new damage jumps back
+// to the maximum, so animations and interaction are never throttled for
+// longer than one evaluation.
+//
+// IsEnabled, NotifyInput and NotifyHidden may be called from any thread;
+// everything else runs on the UI thread.
+class FrameRateGovernor {
+ public:
+  static constexpr DWORD kEvaluationIntervalMs = 250;
+
+  bool IsEnabled() const { return enabled.load(std::memory_order_relaxed); }
+  void Enable(int minFrameRate, int maxFrameRate);
+  void Disable();
+
+  // Both return true when the browser just became active again, in which
+  // case the caller should not wait for the next evaluation.
+  bool NotifyInput();
+  // Called for every frame CEF paints. |clientBehind| is set when the frame
+  // had to overwrite one the client had not acknowledged yet.
+  bool NotifyFrame(bool damaged, bool clientBehind);
+  void NotifyHidden(bool hidden);
+
+  // Returns the frame rate to switch to, if it should change.
+  std::optional<int> Evaluate(int currentFrameRate);
+
+ private:
+  static constexpr ULONGLONG kActiveWindowMs = 1000;
+  static constexpr int kIdleFrameCount = 30;
+
+  std::atomic<bool> enabled{false};
+  int minFrameRate = 1;
+  int maxFrameRate = 60;
+  int ceiling = 60;
+  std::atomic<bool> hidden{false};
+  std::atomic<ULONGLONG> lastInputTick{0};
+  ULONGLONG lastDamageTick = 0;
+  int undamagedFrames = 0;
+  int framesBehind = 0;
+};
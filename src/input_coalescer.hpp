@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "rpc.hpp"
+
+// Merges mouse moves and wheel events that queued up on the receive path.
+//
+// The receive thread hands every decoded request to Add() and calls Flush()
+// once no complete frame is left in the receive buffer. Per browser, at most
+// one move or wheel request is held back: a later move replaces it, a later
+// wheel event with the same modifiers adds its deltas to it. Any other
+// request for that browser, or a move/wheel that cannot be merged, releases
+// the held request first, so input is never reordered within a browser.
+// Client requests release everything held. Receive thread only.
+class InputCoalescer {
+ public:
+  template <typename Dispatch>
+  void Add(RpcRequest&& request, Dispatch&& dispatch) {
+    if (GetRpcMethodInfo(request.method).rpcClass != RpcClass::Browser) {
+      Flush(dispatch);
+      dispatch(std::move(request));
+      return;
+    }
+    bool coalescible = request.method == RpcMethodId::Browser_OnMouseMove ||
+                       request.method == RpcMethodId::Browser_OnMouseWheel;
+    for (size_t i = 0; i < pending.size(); ++i) {
+      if (pending[i].instanceId != request.instanceId) {
+        continue;
+      }
+      if (coalescible && Merge(pending[i], request)) {
+        mergedCount++;
+        return;
+      }
+      RpcRequest held = std::move(pending[i]);
+      pending.erase(pending.begin() + i);
+      dispatch(std::move(held));
+      break;
+    }
+    if (coalescible) {
+      pending.push_back(std::move(request));
+    } else {
+      dispatch(std::move(request));
+    }
+  }
+
+  template <typename Dispatch>
+  void Flush(Dispatch&& dispatch) {
+    for (RpcRequest& request : pending) {
+      dispatch(std::move(request));
+    }
+    pending.clear();
+  }
+
+  // Number of requests folded into an earlier one.
+  uint64_t GetMergedCount() const { return mergedCount; }
+
+ private:
+  // Merges |next| into |held| if both are the same kind of event with the
+  // same modifiers. Malformed arguments are left for the handler to reject.
+  static bool Merge(RpcRequest& held, const RpcRequest& next) {
+    if (held.method != next.method) {
+      return false;
+    }
+    try {
+      return MergeArguments(held, next);
+    } catch (const json::exception&) {
+      return false;
+    }
+  }
+
+  static bool MergeArguments(RpcRequest& held, const RpcRequest& next) {
+    const json& heldEvent = held.arguments.at("event");
+    const json& nextEvent = next.arguments.at("event");
+    if (heldEvent.at("modifiers") != nextEvent.at("modifiers")) {
+      return false;
+    }
+    if (next.method == RpcMethodId::Browser_OnMouseMove) {
+      // Leaving the view is an edge, not a position; keep it separate.
+      if (held.arguments.at("mouseLeave") != next.arguments.at("mouseLeave")) {
+        return false;
+      }
+      held.arguments = next.arguments;
+    } else {
+      int deltaX = held.arguments.at("deltaX").get<int>() +
+                   next.arguments.at("deltaX").get<int>();
+      int deltaY = held.arguments.at("deltaY").get<int>() +
+                   next.arguments.at("deltaY").get<int>();
+      held.arguments = next.arguments;
+      held.arguments["deltaX"] = deltaX;
+      held.arguments["deltaY"] = deltaY;
+    }
+    held.id = next.id;
+    return true;
+  }
+
+  std::vector<RpcRequest> pending;
+  uint64_t mergedCount = 0;
+};
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <SDL3/sdl.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounded multi-producer, single-consumer queue.
+//
+// The slots are allocated once up front and values are moved in and out, so
+// neither side allocates or copies. Pushing and draining are lock-free: each
+// slot carries a sequence number telling whether it is free or holds a value
+// for the current lap of the ring. Threads only block when they have to
+// wait, the consumer on an empty queue and producers on a full one, and the
+// SDL objects behind that are only touched when somebody is waiting.
+//
+// T must be default constructible and move assignable.
+template <typename T, size_t Capacity>
+class MpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+ public:
+  MpscQueue() : slots(new Slot[Capacity]) {
+    for (size_t i = 0; i < Capacity; ++i) {
+      slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    mutex = SDL_CreateMutex();
+    notFull = SDL_CreateCondition();
+    notEmpty = SDL_CreateSemaphore(0);
+    if (!mutex || !notFull || !notEmpty) {
+      SDL_Log("Failed to create MpscQueue synchronization objects");
+      abort();
+    }
+  }
+
+  ~MpscQueue() {
+    SDL_DestroyMutex(mutex);
+    SDL_DestroyCondition(notFull);
+    SDL_DestroySemaphore(notEmpty);
+  }
+
+  // Any thread. Returns false if the queue is full, leaving |value| as is.
+  bool TryPush(T&& value) {
+    size_t position = tail.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = slots[position & (Capacity - 1)];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      intptr_t lap = static_cast<intptr_t>(sequence - position);
+      if (lap == 0) {
+        if (tail.compare_exchange_weak(position, position + 1,
+                                       std::memory_order_relaxed)) {
+          slot.value = std::move(value);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          NotifyConsumer();
+          return true;
+        }
+      } else if (lap < 0) {
+        return false;
+      } else {
+        position = tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Any thread. Waits while the queue is full. Returns false, dropping
+  // |value|, once the queue is closed.
+  bool Push(T&& value) {
+    if (TryPush(std::move(value))) {
+      return true;
+    }
+    SDL_LockMutex(mutex);
+    waitingProducers.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool pushed = false;
+    while (!closed) {
+      pushed = TryPush(std::move(value));
+      if (pushed) {
+        break;
+      }
+      SDL_WaitCondition(notFull, mutex);
+    }
+    waitingProducers.fetch_sub(1);
+    SDL_UnlockMutex(mutex);
+    return pushed;
+  }
+
+  // Consumer only. Moves everything queued into |out| in FIFO order without
+  // blocking and returns how many values that was.
+  size_t Drain(std::vector<T>& out) {
+    size_t count = 0;
+    while (true) {
+      Slot& slot = slots[head & (Capacity - 1)];
+      if (slot.sequence.load(std::memory_order_acquire) != head + 1) {
+        break;
+      }
+      out.push_back(std::move(slot.value));
+      slot.sequence.store(head + Capacity, std::memory_order_release);
+      ++head;
+      ++count;
+    }
+    if (count > 0) {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waitingProducers.load(std::memory_order_relaxed) > 0) {
+        SDL_LockMutex(mutex);
+        SDL_BroadcastCondition(notFull);
+        SDL_UnlockMutex(mutex);
+      }
+    }
+    return count;
+  }
+
+  // Consumer only. Blocks until a value is pushed or Wake is called; may
+  // return early.
+  void Wait() {
+    consumerWaiting.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!IsEmpty() || wakeRequested.exchange(false)) {
+      if (consumerWaiting.exchange(false)) {
+        return;
+      }
+      // A producer saw us waiting and is about to signal; take that signal
+      // so it does not cut the next wait short.
+    }
+    SDL_WaitSemaphore(notEmpty);
+  }
+
+  // Any thread. Ends the consumer's current or next Wait, for work it finds
+  // somewhere other than this queue.
+  void Wake() {
+    wakeRequested.store(true, std::memory_order_relaxed);
+    NotifyConsumer();
+  }
+
+  // Releases producers waiting for room; later pushes to a full queue fail.
+  void Close() {
+    SDL_LockMutex(mutex);
+    closed = true;
+    SDL_BroadcastCondition(notFull);
+    SDL_UnlockMutex(mutex);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  void NotifyConsumer() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting.load(std::memory_order_relaxed) &&
+        consumerWaiting.exchange(false)) {
+      SDL_SignalSemaphore(notEmpty);
+    }
+  }
+
+  // Consumer only.
+  bool IsEmpty() const {
+    return slots[head & (Capacity - 1)].sequence.load(
+               std::memory_order_acquire) != head + 1;
+  }
+
+  std::unique_ptr<Slot[]> slots;
+  alignas(64) std::atomic<size_t> tail{0};
+  alignas(64) size_t head = 0;
+  std::atomic<bool> consumerWaiting{false};
+  std::atomic<bool> wakeRequested{false};
+  std::atomic<int> waitingProducers{0};
+  SDL_Mutex* mutex;
+  SDL_Condition* notFull;
+  SDL_Semaphore* notEmpty;
+  bool closed = false;
+};
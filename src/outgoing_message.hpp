@@ -0,0 +1,86 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
+
+#include "rpc.hpp"
+#include "wire_encoding.hpp"
+
+// Arguments of a request the runner sends to the client. CEF callbacks move
+// their Browser_* struct in here and the send thread converts it to JSON, so
+// neither building the JSON tree nor encoding it happens on a CEF thread.
+// Arguments without a struct of their own are passed as json.
+using OutgoingArguments = std::variant<json,
+                                       Browser_OnPaint,
+                                       Browser_OnPaintSurfaceCreated,
+                                       Browser_OnAcceleratedPaint,
+                                       Browser_OnTextSelectionChanged,
+                                       Browser_GetScreenPoint,
+                                       Browser_OnPopupShow,
+                                       Browser_OnPopupSize,
+                                       Browser_OnTitleChange,
+                                       Browser_OnConsoleMessage,
+                                       Browser_OnLoadingProgressChange,
+                                       Browser_OnFaviconUrlChange,
+                                       Browser_OnCursorChange,
+                                       Browser_OnBeforePopup,
+                                       Browser_OnBeforeBrowse,
+                                       Browser_OnOpenUrlFromTab,
+                                       Browser_OnBeforeContextMenu,
+                                       Browser_OnContextMenuCommand,
+                                       Browser_OnLoadingStateChange,
+                                       Browser_OnLoadStart,
+                                       Browser_OnLoadEnd,
+                                       Browser_OnLoadError,
+                                       Browser_OnTooltip>;
+
+struct OutgoingRequest {
+  RpcId id;
+  RpcMethodId method = RpcMethodId::Unknown;
+  int instanceId = 0;
+  OutgoingArguments arguments;
+};
+
+// A JSON message produced by the renderer process, transcoded only if the
+// wire encoding is not JSON. |method| and |instanceId| are known when the
+// renderer message carries a single kind of request.
+struct ForwardedJson {
+  std::string payload;
+  RpcMethodId method = RpcMethodId::Unknown;
+  int instanceId = 0;
+};
+
+// Everything queued for the send thread. The send thread picks the encoding
+// when it writes the message: the lanes reorder messages, so only the order
+// of the written stream tells which side of the handshake a message is on.
+// |switchEncoding| is set on the handshake response; the messages written
+// after it use the negotiated encoding.
+struct OutgoingMessage {
+  RpcPriority priority = RpcPriority::Blocking;
+  std::variant<json, OutgoingRequest, ForwardedJson> body;
+  std::optional<WireEncoding> switchEncoding;
+};
+
+// Throws nlohmann::json::exception if the message cannot be encoded.
+inline std::string EncodeOutgoingMessage(OutgoingMessage& message,
+                                         WireEncoding encoding) {
+  if (auto* forwarded = std::get_if<ForwardedJson>(&message.body)) {
+    if (encoding == WireEncoding::Json) {
+      return std::move(forwarded->payload);
+    }
+    return EncodeMessage(json::parse(forwarded->payload), encoding);
+  }
+  if (auto* outgoing = std::get_if<OutgoingRequest>(&message.body)) {
+    RpcRequest request;
+    request.id = std::move(outgoing->id);
+    request.method = outgoing->method;
+    request.instanceId = outgoing->instanceId;
+    request.arguments = std::visit(
+        [](auto& arguments) { return json(std::move(arguments)); },
+        outgoing->arguments);
+    return EncodeMessage(json(request), encoding);
+  }
+  return EncodeMessage(std::get<json>(message.body), encoding);
+}
@@ -0,0 +1,331 @@
+#include "outgoing_message_queue.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+OutgoingMessageQueue::OutgoingMessageQueue() {
+  overflowMutex = SDL_CreateMutex();
+  weightsMutex = SDL_CreateMutex();
+  statsMutex = SDL_CreateMutex();
+  if (!overflowMutex || !weightsMutex || !statsMutex) {
+    SDL_Log("Failed to create OutgoingMessageQueue synchronization objects");
+    abort();
+  }
+}
+
+OutgoingMessageQueue::~OutgoingMessageQueue() {
+  SDL_DestroyMutex(overflowMutex);
+  SDL_DestroyMutex(weightsMutex);
+  SDL_DestroyMutex(statsMutex);
+}
+
+bool OutgoingMessageQueue::Push(OutgoingMessage&& message) {
+  if (ingress.TryPush(std::move(message))) {
+    return true;
+  }
+  if (std::holds_alternative<json>(message.body)) {
+    SDL_LockMutex(overflowMutex);
+    if (!closed.load()) {
+      overflow.push_back(std::move(message));
+      hasOverflow.store(true);
+    }
+    SDL_UnlockMutex(overflowMutex);
+    ingress.Wake();
+    return true;
+  }
+  if (message.priority == RpcPriority::Log) {
+    ingressDroppedLogCount++;
+    return false;
+  }
+  blockedPushCount++;
+  return ingress.Push(std::move(message));
+}
+
+void OutgoingMessageQueue::PopBatch(std::vector<OutgoingMessage>& out) {
+  ApplyWeightChanges();
+  Admit();
+  while (GetSize() == 0) {
+    ingress.Wait();
+    ApplyWeightChanges();
+    Admit();
+  }
+
+  // Responses go first, so anything a response announces, like the browser
+  // Client.CreateBrowser returns, is known before its events arrive.
+  while (!responses.empty()) {
+    out.push_back(std::move(responses.front()));
+    responses.pop_front();
+  }
+
+  std::array<size_t, kRpcPriorityCount> counts{};
+  size_t room = kMaxBatchSize;
+  for (size_t i = 0; i < lanes.size(); ++i) {
+    counts[i] = std::min(lanes[i].size, kLaneReserve);
+    room -= counts[i];
+  }
+  for (size_t i = 0; i < lanes.size() && room > 0; ++i) {
+    size_t extra = std::min(lanes[i].size - counts[i], room);
+    counts[i] += extra;
+    room -= extra;
+  }
+
+  for (size_t i = 0; i < lanes.size(); ++i) {
+    Take(lanes[i], counts[i], out);
+  }
+  // Refill right away, so producers waiting for room in the ingress can go
+  // on while this batch is written.
+  Admit();
+  PublishStats();
+}
+
+void OutgoingMessageQueue::Close() {
+  SDL_LockMutex(overflowMutex);
+  closed.store(true);
+  overflow.clear();
+  SDL_UnlockMutex(overflowMutex);
+  ingress.Close();
+  responses.clear();
+  for (Lane& lane : lanes) {
+    lane.flows.clear();
+    lane.active.clear();
+    lane.size = 0;
+  }
+  coalescible.clear();
+  arrived.clear();
+  nextArrived = 0;
+}
+
+void OutgoingMessageQueue::SetWeight(int instanceId, int weight) {
+  SDL_LockMutex(weightsMutex);
+  weightChanges[instanceId] = std::clamp(weight, 1, kMaxWeight);
+  weightsChanged.store(true);
+  SDL_UnlockMutex(weightsMutex);
+}
+
+void OutgoingMessageQueue::RemoveBrowser(int instanceId) {
+  SDL_LockMutex(weightsMutex);
+  weightChanges[instanceId] = 0;
+  weightsChanged.store(true);
+  SDL_UnlockMutex(weightsMutex);
+}
+
+OutgoingMessageQueue::Stats OutgoingMessageQueue::GetStats() {
+  SDL_LockMutex(statsMutex);
+  Stats result = stats;
+  SDL_UnlockMutex(statsMutex);
+  result.droppedLogs += ingressDroppedLogCount.load();
+  result.blockedPushes = blockedPushCount.load();
+  return result;
+}
+
+bool OutgoingMessageQueue::IsLastValueWins(RpcMethodId method) {
+  switch (method) {
+    case RpcMethodId::Browser_OnLoadingProgressChange:
+    case RpcMethodId::Browser_OnMouseOver:
+    case RpcMethodId::Browser_OnTooltip:
+    case RpcMethodId::Browser_OnCursorChange:
+    case RpcMethodId::Browser_OnTextSelectionChanged:
+      return true;
+    default:
+      return false;
+  }
+}
+
+int OutgoingMessageQueue::GetInstanceId(const OutgoingMessage& message) {
+  if (auto* request = std::get_if<OutgoingRequest>(&message.body)) {
+    return request->instanceId;
+  }
+  if (auto* forwarded = std::get_if<ForwardedJson>(&message.body)) {
+    return forwarded->instanceId;
+  }
+  return 0;
+}
+
+uint64_t OutgoingMessageQueue::GetCoalescingKey(
+    const OutgoingMessage& message) {
+  RpcMethodId method = RpcMethodId::Unknown;
+  if (auto* request = std::get_if<OutgoingRequest>(&message.body)) {
+    method = request->method;
+  } else if (auto* forwarded = std::get_if<ForwardedJson>(&message.body)) {
+    method = forwarded->method;
+  }
+  if (!IsLastValueWins(method)) {
+    return 0;
+  }
+  uint32_t instanceId = static_cast<uint32_t>(GetInstanceId(message));
+  return (static_cast<uint64_t>(instanceId) << 16) |
+         static_cast<uint16_t>(method);
+}
+
+void OutgoingMessageQueue::Admit() {
+  AdmitOverflow();
+  while (true) {
+    if (nextArrived == arrived.size()) {
+      // Also before every drain, so a response that overflowed is admitted
+      // ahead of anything its producer pushed after it.
+      AdmitOverflow();
+      arrived.clear();
+      nextArrived = 0;
+      if (ingress.Drain(arrived) == 0) {
+        return;
+      }
+    }
+    while (nextArrived < arrived.size()) {
+      if (!AdmitOne(arrived[nextArrived])) {
+        return;
+      }
+      nextArrived++;
+    }
+  }
+}
+
+void OutgoingMessageQueue::AdmitOverflow() {
+  if (!hasOverflow.exchange(false)) {
+    return;
+  }
+  SDL_LockMutex(overflowMutex);
+  for (OutgoingMessage& message : overflow) {
+    AdmitOne(message);
+  }
+  overflow.clear();
+  SDL_UnlockMutex(overflowMutex);
+}
+
+bool OutgoingMessageQueue::AdmitOne(OutgoingMessage& message) {
+  if (std::holds_alternative<json>(message.body)) {
+    responses.push_back(std::move(message));
+    return true;
+  }
+  uint64_t key = GetCoalescingKey(message);
+  if (key != 0) {
+    auto queued = coalescible.find(key);
+    if (queued != coalescible.end()) {
+      *queued->second = std::move(message);
+      coalescedCount++;
+      return true;
+    }
+  }
+  if (GetSize() >= kCapacity) {
+    if (message.priority == RpcPriority::Log) {
+      droppedLogCount++;
+      if (!DropLog()) {
+        return true;
+      }
+    } else {
+      return false;
+    }
+  }
+
+  int instanceId = GetInstanceId(message);
+  Lane& lane = lanes[static_cast<size_t>(message.priority)];
+  Flow& flow = lane.flows[instanceId];
+  if (flow.messages.empty()) {
+    lane.active.push_back(instanceId);
+  }
+  flow.messages.push_back(std::move(message));
+  lane.size++;
+  if (key != 0) {
+    coalescible[key] = &flow.messages.back();
+  }
+  return true;
+}
+
+void OutgoingMessageQueue::ApplyWeightChanges() {
+  if (!weightsChanged.exchange(false)) {
+    return;
+  }
+  SDL_LockMutex(weightsMutex);
+  for (const auto& [instanceId, weight] : weightChanges) {
+    if (weight == 0) {
+      weights.erase(instanceId);
+    } else {
+      weights[instanceId] = weight;
+    }
+  }
+  weightChanges.clear();
+  SDL_UnlockMutex(weightsMutex);
+}
+
+void OutgoingMessageQueue::PublishStats() {
+  std::map<int, size_t> browserDepths;
+  for (const Lane& lane : lanes) {
+    for (const auto& [instanceId, flow] : lane.flows) {
+      if (instanceId != 0) {
+        browserDepths[instanceId] += flow.messages.size();
+      }
+    }
+  }
+  SDL_LockMutex(statsMutex);
+  stats.depth = GetSize() + (arrived.size() - nextArrived);
+  stats.browserDepths = std::move(browserDepths);
+  stats.coalesced = coalescedCount;
+  stats.droppedLogs = droppedLogCount;
+  SDL_UnlockMutex(statsMutex);
+}
+
+size_t OutgoingMessageQueue::GetSize() const {
+  size_t size = responses.size();
+  for (const Lane& lane : lanes) {
+    size += lane.size;
+  }
+  return size;
+}
+
+int OutgoingMessageQueue::GetWeight(int instanceId) const {
+  auto weight = weights.find(instanceId);
+  return weight == weights.end() ? kDefaultWeight : weight->second;
+}
+
+void OutgoingMessageQueue::Take(Lane& lane,
+                                size_t count,
+                                std::vector<OutgoingMessage>& out) {
+  while (count > 0 && !lane.active.empty()) {
+    int instanceId = lane.active.front();
+    Flow& flow = lane.flows[instanceId];
+    if (flow.deficit <= 0) {
+      flow.deficit += GetWeight(instanceId);
+    }
+    while (count > 0 && flow.deficit > 0 && !flow.messages.empty()) {
+      uint64_t key = GetCoalescingKey(flow.messages.front());
+      if (key != 0) {
+        coalescible.erase(key);
+      }
+      out.push_back(std::move(flow.messages.front()));
+      flow.messages.pop_front();
+      flow.deficit--;
+      lane.size--;
+      count--;
+    }
+    if (flow.messages.empty()) {
+      // An idle browser does not bank credit for later.
+      lane.flows.erase(instanceId);
+      lane.active.pop_front();
+    } else if (flow.deficit <= 0) {
+      lane.active.pop_front();
+      lane.active.push_back(instanceId);
+    }
+    // Otherwise the batch is full and the browser resumes its turn in the
+    // next one.
+  }
+}
+
+bool OutgoingMessageQueue::DropLog() {
+  Lane& lane = lanes[static_cast<size_t>(RpcPriority::Log)];
+  auto largest = std::max_element(
+      lane.flows.begin(), lane.flows.end(), [](const auto& a, const auto& b) {
+        return a.second.messages.size() < b.second.messages.size();
+      });
+  if (largest == lane.flows.end()) {
+    return false;
+  }
+  int instanceId = largest->first;
+  Flow& flow = largest->second;
+  flow.messages.pop_front();
+  lane.size--;
+  if (flow.messages.empty()) {
+    lane.flows.erase(largest);
+    lane.active.erase(
+        std::find(lane.active.begin(), lane.active.end(), instanceId));
+  }
+  return true;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <SDL3/sdl.h>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+#include "outgoing_message.hpp"
+
+// Queue between the threads producing outgoing messages and the send thread.
+//
+// Producers only touch a lock-free MpscQueue. The send thread moves what
+// arrived there into its own lanes, one per RpcPriority, and picks each
+// batch from those; the lanes need no locking since only it uses them.
+//
+// Responses to client requests bypass the lanes: each batch starts with all
+// that arrived, so a message never goes out ahead of a response queued
+// before it. A browser's events are only queued once Client.CreateBrowser
+// has been answered, so the client always learns the browser id first.
+//
+// Besides the responses, each PopBatch takes at most kMaxBatchSize
+// messages: every non-empty lane first gets up to kLaneReserve of them, then
+// the remaining room goes to the lanes in priority order. A burst of console
+// messages therefore delays a paint by at most one reserved share per write,
+// while the lower lanes still make progress when paints keep coming. The
+// batch lists the lanes in priority order, so the client also handles the
+// urgent messages first.
+//
+// Within a lane, every browser has its own FIFO, and messages not tied to a
+// browser share the FIFO of instance 0. The lane is drained from these by
+// deficit round robin, counting messages: on its turn a browser may send as
+// many messages as its weight, so one chatty page cannot hold up the others
+// for longer than a round. Messages are only ordered within one browser's
+// FIFO of one lane.
+//
+// The lanes hold about kCapacity messages, so a stalled client cannot make
+// the queue grow without bound:
+// - Events that only report the latest value (see IsLastValueWins) are kept
+//   once per browser and method; a newer one replaces the queued one in
+//   place, so a client catching up only sees the current state.
+// - Log lane messages are dropped when the lanes are full, oldest first from
+//   the browser with the most of them queued, or when the ingress is full.
+// - Responses are always accepted. They are produced on the receive
+//   thread, which has to keep reading for the client to drain its own side,
+//   and the client bounds them by the requests it sends.
+// - Everything else is never dropped: it stays in the ingress until the
+//   lanes have room, and once that fills up, Push waits for as long as it
+//   takes, which holds up the CEF thread producing the message. A client
+//   that stops reading thus stops the browsers rather than missing events.
+class OutgoingMessageQueue {
+ public:
+  static constexpr size_t kMaxBatchSize = 64;
+  static constexpr size_t kLaneReserve = 4;
+  static constexpr size_t kCapacity = 4096;
+  static constexpr size_t kIngressCapacity = 1024;
+  static constexpr int kDefaultWeight = 1;
+  static constexpr int kMaxWeight = 16;
+
+  struct Stats {
+    size_t depth = 0;
+    // Queued messages per browser, across lanes.
+    std::map<int, size_t> browserDepths;
+    uint64_t coalesced = 0;
+    uint64_t droppedLogs = 0;
+    uint64_t blockedPushes = 0;
+  };
+
+  OutgoingMessageQueue();
+  ~OutgoingMessageQueue();
+
+  // Returns false if |message| was dropped, which only happens to log
+  // messages and once the queue is closed.
+  bool Push(OutgoingMessage&& message);
+
+  // Send thread only. Blocks until a message is available, then appends the
+  // next batch to |out|.
+  void PopBatch(std::vector<OutgoingMessage>& out);
+
+  // Send thread only, once it stops. Releases blocked producers and discards
+  // everything pushed afterwards.
+  void Close();
+
+  // Weight is clamped to 1..kMaxWeight. RemoveBrowser drops it again.
+  void SetWeight(int instanceId, int weight);
+  void RemoveBrowser(int instanceId);
+
+  // As of the last batch.
+  Stats GetStats();
+
+ private:
+  struct Flow {
+    std::deque<OutgoingMessage> messages;
+    // Messages the flow may still send in its current turn.
+    int deficit = 0;
+  };
+
+  struct Lane {
+    std::unordered_map<int, Flow> flows;
+    // Browsers with queued messages, in round robin order.
+    std::deque<int> active;
+    size_t size = 0;
+  };
+
+  static bool IsLastValueWins(RpcMethodId method);
+  static int GetInstanceId(const OutgoingMessage& message);
+  // Browser and method of a last-value-wins event, or 0.
+  static uint64_t GetCoalescingKey(const OutgoingMessage& message);
+
+  // Moves arrived messages into the lanes until they are full.
+  void Admit();
+  void AdmitOverflow();
+  // Returns false if |message| has to wait for room.
+  bool AdmitOne(OutgoingMessage& message);
+  void ApplyWeightChanges();
+  void PublishStats();
+  size_t GetSize() const;
+  int GetWeight(int instanceId) const;
+  void Take(Lane& lane, size_t count, std::vector<OutgoingMessage>& out);
+  bool DropLog();
+
+  MpscQueue<OutgoingMessage, kIngressCapacity> ingress;
+  // Responses that found the ingress full.
+  SDL_Mutex* overflowMutex;
+  std::vector<OutgoingMessage> overflow;
+  std::atomic<bool> hasOverflow{false};
+  std::atomic<bool> closed{false};
+
+  // Weight changes not yet seen by the send thread; 0 removes the weight.
+  SDL_Mutex* weightsMutex;
+  std::unordered_map<int, int> weightChanges;
+  std::atomic<bool> weightsChanged{false};
+
+  // Send thread only.
+  // Responses to client requests, written ahead of every lane.
+  std::deque<OutgoingMessage> responses;
+  std::array<Lane, kRpcPriorityCount> lanes;
+  std::unordered_map<int, int> weights;
+  // Queued last-value-wins events. Flows only lose messages at the front,
+  // which leaves pointers to the others valid.
+  std::unordered_map<uint64_t, OutgoingMessage*> coalescible;
+  // Arrived messages not admitted to the lanes yet.
+  std::vector<OutgoingMessage> arrived;
+  size_t nextArrived = 0;
+  uint64_t coalescedCount = 0;
+  uint64_t droppedLogCount = 0;
+
+  std::atomic<uint64_t> ingressDroppedLogCount{0};
+  std::atomic<uint64_t> blockedPushCount{0};
+  SDL_Mutex* statsMutex;
+  Stats stats;
+};
@@ -0,0 +1,148 @@
+#include "paint_surface_pool.h"
+
+#include <SDL3/sdl.h>
+
+#include "pixel_ops.h"
+
+namespace {
+
+// Allocation fails under memory pressure, which usually lasts a while;
+// retrying on every frame would only add to it.
+const uint64_t kAllocationRetryIntervalMs = 1000;
+
+}  // namespace
+
+PaintSurfacePool::PaintSurfacePool(HANDLE clientProcessHandle)
+    : clientProcessHandle(clientProcessHandle) {}
+
+PaintSurfacePool::~PaintSurfacePool() {
+  Release();
+}
+
+bool PaintSurfacePool::EnsureSize(int newWidth, int newHeight, int count) {
+  if (IsValid() && newWidth == width && newHeight == height &&
+      count == GetCount()) {
+    return false;
+  }
+  if (!IsValid() && SDL_GetTicks() < retryAt) {
+    return false;
+  }
+
+  Release();
+  width = newWidth;
+  height = newHeight;
+  surfaceSize = static_cast<size_t>(newWidth) * newHeight * 4;
+  ++generation;
+
+  surfaces.resize(count);
+  for (Surface& surface : surfaces) {
+    if (!Allocate(surface)) {
+      // The client never learns about these handles, so it cannot close
+      // them itself.
+      CloseClientHandles();
+      Release();
+      retryAt = SDL_GetTicks() + kAllocationRetryIntervalMs;
+      return false;
+    }
+    surface.damage.push_back(CefRect(0, 0, width, height));
+  }
+  return true;
+}
+
+int PaintSurfacePool::AcquireSurface() {
+  int oldest = 0;
+  for (int i = 0; i < GetCount(); ++i) {
+    if (surfaces[i].pendingAcks == 0) {
+      return i;
+    }
+    if (surfaces[i].lastFrame < surfaces[oldest].lastFrame) {
+      oldest = i;
+    }
+  }
+  return oldest;
+}
+
+std::vector<CefRect> PaintSurfacePool::BeginFrame(
+    int index,
+    const std::vector<CefRect>& dirtyRects) {
+  CefRect bounds(0, 0, width, height);
+  for (int i = 0; i < GetCount(); ++i) {
+    if (i == index) {
+      continue;
+    }
+    std::vector<CefRect>& damage = surfaces[i].damage;
+    damage.insert(damage.end(), dirtyRects.begin(), dirtyRects.end());
+    damage = MergeDirtyRects(damage, bounds);
+  }
+
+  Surface& surface = surfaces[index];
+  surface.damage.insert(surface.damage.end(), dirtyRects.begin(),
+                        dirtyRects.end());
+  std::vector<CefRect> copyRects = MergeDirtyRects(surface.damage, bounds);
+  surface.damage.clear();
+  return copyRects;
+}
+
+void PaintSurfacePool::MarkSent(int index) {
+  surfaces[index].pendingAcks++;
+  surfaces[index].lastFrame = ++frameCounter;
+}
+
+void PaintSurfacePool::Acknowledge(uint32_t ackGeneration, int index) {
+  if (ackGeneration != generation || index < 0 || index >= GetCount()) {
+    return;
+  }
+  if (surfaces[index].pendingAcks > 0) {
+    surfaces[index].pendingAcks--;
+  }
+}
+
+bool PaintSurfacePool::Allocate(Surface& surface) {
+  surface.mapping = CreateFileMappingW(
+      INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+      static_cast<DWORD>(static_cast<uint64_t>(surfaceSize) >> 32),
+      static_cast<DWORD>(surfaceSize), NULL);
+  if (surface.mapping == NULL) {
+    SDL_Log("Error creating file mapping for paint surface: %lu",
+            GetLastError());
+    return false;
+  }
+  surface.pixels = static_cast<uint8_t*>(
+      MapViewOfFile(surface.mapping, FILE_MAP_WRITE, 0, 0, surfaceSize));
+  if (surface.pixels == nullptr) {
+    SDL_Log("Error mapping view of paint surface: %lu", GetLastError());
+    return false;
+  }
+  HANDLE duplicateHandle = NULL;
+  if (!DuplicateHandle(GetCurrentProcess(), surface.mapping,
+                       clientProcessHandle, &duplicateHandle, 0, FALSE,
+                       DUPLICATE_SAME_ACCESS)) {
+    SDL_Log("Error duplicating paint surface handle: %lu", GetLastError());
+    return false;
+  }
+  surface.clientHandle = reinterpret_cast<uintptr_t>(duplicateHandle);
+  return true;
+}
+
+void PaintSurfacePool::Release() {
+  for (Surface& surface : surfaces) {
+    if (surface.pixels) {
+      UnmapViewOfFile(surface.pixels);
+    }
+    if (surface.mapping) {
+      CloseHandle(surface.mapping);
+    }
+  }
+  surfaces.clear();
+}
+
+void PaintSurfacePool::CloseClientHandles() {
+  for (Surface& surface : surfaces) {
+    if (surface.clientHandle) {
+      DuplicateHandle(clientProcessHandle,
+                      reinterpret_cast<HANDLE>(surface.clientHandle), NULL,
+                      NULL, 0, FALSE, DUPLICATE_CLOSE_SOURCE);
+      surface.clientHandle = 0;
+    }
+  }
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+#include <vector>
+
+#include "include/internal/cef_types_wrappers.h"
+
+// Shared memory surfaces that OnPaint copies frames into.
+//
+// Surfaces are allocated once per size and duplicated into the client
+// process at that point; frames then only name a surface by index. Every
+// allocation bumps the generation so the client can tell which set of
+// handles a frame refers to. The client owns its duplicated handles and
+// should close the previous generation's once a new one is announced.
+//
+// With more than one surface, frames are pipelined: a surface is in flight
+// from the frame being sent until the client acknowledges it. Each surface
+// remembers the damage of frames written to the other surfaces since its
+// own last write, so bringing it up to date still only copies what changed.
+class PaintSurfacePool {
+ public:
+  struct Surface {
+    HANDLE mapping = NULL;
+    uint8_t* pixels = nullptr;
+    uintptr_t clientHandle = 0;
+    // Regions that are stale relative to the latest frame. A new surface is
+    // stale everywhere.
+    std::vector<CefRect> damage;
+    // Frames sent from this surface that the client has not acknowledged.
+    int pendingAcks = 0;
+    uint64_t lastFrame = 0;
+  };
+
+  explicit PaintSurfacePool(HANDLE clientProcessHandle);
+  ~PaintSurfacePool();
+
+  // Makes sure there are |count| surfaces of |width| x |height| BGRA pixels.
+  // Returns true if they had to be reallocated, in which case the caller
+  // announces the new generation to the client. On failure the pool is left
+  // empty and IsValid() returns false, and further calls do not try again
+  // until a retry interval has passed.
+  bool EnsureSize(int width, int height, int count);
+
+  // Releases all surfaces, so that the next EnsureSize allocates a new
+  // generation.
+  void Reset() { Release(); }
+
+  // Like Reset, for a generation the client could not be told about: also
+  // closes the handles duplicated into the client process.
+  void Discard() {
+    CloseClientHandles();
+    Release();
+  }
+
+  // Picks the surface for the next frame: one the client is done with if
+  // possible, otherwise the one holding the oldest unacknowledged frame.
+  int AcquireSurface();
+
+  // Records a new frame with |dirtyRects| about to be written to surface
+  // |index|. Returns the rectangles that have to be copied into it.
+  std::vector<CefRect> BeginFrame(int index,
+                                  const std::vector<CefRect>& dirtyRects);
+  void MarkSent(int index);
+  void Acknowledge(uint32_t generation, int index);
+
+  bool IsValid() const { return !surfaces.empty(); }
+  int GetWidth() const { return width; }
+  int GetHeight() const { return height; }
+  int GetStride() const { return width * 4; }
+  size_t GetSurfaceSize() const { return surfaceSize; }
+  uint32_t GetGeneration() const { return generation; }
+  int GetCount() const { return static_cast<int>(surfaces.size()); }
+  Surface& GetSurface(int index) { return surfaces[index]; }
+
+ private:
+  bool Allocate(Surface& surface);
+  void Release();
+  // Closes the handles duplicated into the client, for a generation that
+  // was never announced to it.
+  void CloseClientHandles();
+
+  HANDLE clientProcessHandle;
+  int width = 0;
+  int height = 0;
+  size_t surfaceSize = 0;
+  uint32_t generation = 0;
+  uint64_t frameCounter = 0;
+  // SDL_GetTicks() before which a failed allocation is not retried.
+  uint64_t retryAt = 0;
+  std::vector<Surface> surfaces;
+};
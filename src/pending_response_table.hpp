@@ -0,0 +1,171 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Fixed table of RPC responses that CEF threads are blocked on.
+//
+// A caller reserves a slot for its request id before sending the request, so
+// a response can never arrive before there is somewhere to put it. The
+// receive thread moves the decoded return value into the slot and wakes the
+// caller through WaitOnAddress; no locks or allocations are involved.
+//
+// Slots are found by open addressing on the request id. Each slot moves
+// through Free -> Claimed -> Reserved -> Completing -> Ready -> Free, and only
+// the thread that won the transition into a state may write the slot's other
+// fields. A waiter that gives up moves its slot from Reserved to Abandoned
+// instead; the slot keeps its id so a late response can still be recognized,
+// and Reserve reclaims abandoned slots like free ones.
+class PendingResponseTable {
+ public:
+  static constexpr size_t kCapacity = 256;
+
+  enum class CompleteResult {
+    Delivered,
+    // The waiter had already timed out.
+    Late,
+    // No request with this id was waited on.
+    Unmatched,
+  };
+
+  // Returns false when every slot is taken.
+  bool Reserve(uint64_t id) {
+    for (size_t probe = 0; probe < kCapacity; ++probe) {
+      Slot& slot = slots[(id + probe) & (kCapacity - 1)];
+      uint32_t expected = slot.state.load(std::memory_order_relaxed);
+      if ((expected == kFree || expected == kAbandoned) &&
+          slot.state.compare_exchange_strong(expected, kClaimed,
+                                             std::memory_order_acquire)) {
+        slot.id.store(id, std::memory_order_relaxed);
+        slot.state.store(kReserved, std::memory_order_release);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Releases a reserved slot whose request was never sent.
+  void Cancel(uint64_t id) {
+    Slot* slot = Find(id);
+    if (slot) {
+      uint32_t expected = kReserved;
+      slot->state.compare_exchange_strong(expected, kFree,
+                                          std::memory_order_release);
+    }
+  }
+
+  // Called by the receive thread. |value| is only moved from when the
+  // response is delivered.
+  CompleteResult Complete(uint64_t id, json&& value) {
+    for (size_t probe = 0; probe < kCapacity; ++probe) {
+      Slot& slot = slots[(id + probe) & (kCapacity - 1)];
+      if (slot.id.load(std::memory_order_relaxed) != id) {
+        continue;
+      }
+      uint32_t expected = kAbandoned;
+      if (slot.state.compare_exchange_strong(expected, kClaimed,
+                                             std::memory_order_acquire)) {
+        // Claimed keeps Reserve away while the id is checked again.
+        bool late = slot.id.load(std::memory_order_relaxed) == id;
+        slot.state.store(late ? kFree : kAbandoned, std::memory_order_release);
+        if (late) {
+          return CompleteResult::Late;
+        }
+        continue;
+      }
+      if (expected != kReserved ||
+          !slot.state.compare_exchange_strong(expected, kCompleting,
+                                              std::memory_order_acquire)) {
+        continue;
+      }
+      // The id cannot change while the slot is Completing.
+      if (slot.id.load(std::memory_order_relaxed) != id) {
+        slot.state.store(kReserved, std::memory_order_release);
+        continue;
+      }
+      slot.value = std::move(value);
+      slot.state.store(kReady, std::memory_order_release);
+      WakeByAddressSingle(&slot.state);
+      return CompleteResult::Delivered;
+    }
+    return CompleteResult::Unmatched;
+  }
+
+  // Blocks until the response for a reserved |id| arrives and returns it, or
+  // returns nullopt once |timeoutMs| has passed. INFINITE waits forever.
+  std::optional<json> Wait(uint64_t id, DWORD timeoutMs) {
+    Slot* slot = Find(id);
+    if (!slot) {
+      return std::nullopt;
+    }
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    uint32_t state = slot->state.load(std::memory_order_acquire);
+    while (state != kReady) {
+      DWORD remaining = INFINITE;
+      if (timeoutMs != INFINITE) {
+        ULONGLONG now = GetTickCount64();
+        remaining = now < deadline ? static_cast<DWORD>(deadline - now) : 0;
+      }
+      if (remaining == 0) {
+        uint32_t expected = kReserved;
+        if (slot->state.compare_exchange_strong(expected, kAbandoned,
+                                                std::memory_order_acq_rel)) {
+          return std::nullopt;
+        }
+        // The response is being written right now; it is worth the wait.
+        timeoutMs = INFINITE;
+        state = slot->state.load(std::memory_order_acquire);
+        continue;
+      }
+      WaitOnAddress(&slot->state, &state, sizeof(state), remaining);
+      state = slot->state.load(std::memory_order_acquire);
+    }
+    return Take(*slot);
+  }
+
+ private:
+  enum : uint32_t {
+    kFree,
+    kClaimed,
+    kReserved,
+    kCompleting,
+    kReady,
+    kAbandoned,
+  };
+
+  struct alignas(64) Slot {
+    std::atomic<uint32_t> state{kFree};
+    std::atomic<uint64_t> id{0};
+    json value;
+  };
+
+  // Only valid from the thread that reserved |id|: the slot cannot be freed
+  // or reused underneath it.
+  Slot* Find(uint64_t id) {
+    for (size_t probe = 0; probe < kCapacity; ++probe) {
+      Slot& slot = slots[(id + probe) & (kCapacity - 1)];
+      uint32_t state = slot.state.load(std::memory_order_acquire);
+      if (state != kFree && state != kClaimed && state != kAbandoned &&
+          slot.id.load(std::memory_order_relaxed) == id) {
+        return &slot;
+      }
+    }
+    return nullptr;
+  }
+
+  json Take(Slot& slot) {
+    json value = std::move(slot.value);
+    slot.value = nullptr;
+    slot.state.store(kFree, std::memory_order_release);
+    return value;
+  }
+
+  Slot slots[kCapacity];
+};
@@ -0,0 +1,415 @@
+#include "pixel_ops.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define PIXEL_OPS_SSE2 1
+#endif
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#include <nmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define PIXEL_OPS_TARGET_SSE42
+#define PIXEL_OPS_TARGET_AVX2
+#else
+#define PIXEL_OPS_TARGET_SSE42 __attribute__((target("sse4.2")))
+#define PIXEL_OPS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#define PIXEL_OPS_CRC32 1
+#define PIXEL_OPS_AVX2 1
+#endif
+
+namespace {
+
+void CopyRow(uint8_t* destination, const uint8_t* source, size_t size) {
+#if defined(PIXEL_OPS_SSE2)
+  while (size >= 64) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 32));
+    __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 48));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination), a);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 16), b);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 32), c);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + 48), d);
+    source += 64;
+    destination += 64;
+    size -= 64;
+  }
+  while (size >= 16) {
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i*>(destination),
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(source)));
+    source += 16;
+    destination += 16;
+    size -= 16;
+  }
+#endif
+  memcpy(destination, source, size);
+}
+
+#if defined(PIXEL_OPS_CRC32)
+bool HasSse42() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 20)) != 0;
+#else
+  return __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+// Also requires the OS to save the YMM registers.
+bool HasAvx2() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  bool osxsave = (info[2] & (1 << 27)) != 0;
+  if (!osxsave || (_xgetbv(0) & 6) != 6) {
+    return false;
+  }
+  __cpuidex(info, 7, 0);
+  return (info[1] & (1 << 5)) != 0;
+#else
+  return __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Two independent CRC streams per row hide most of the instruction's
+// latency.
+PIXEL_OPS_TARGET_SSE42
+uint64_t HashRowsCrc32(const uint8_t* source,
+                       size_t sourceStride,
+                       size_t rowSize,
+                       int rows) {
+  uint64_t a = 0;
+  uint64_t b = ~0ull;
+  for (int y = 0; y < rows; ++y) {
+    const uint8_t* row = source + y * sourceStride;
+    size_t i = 0;
+    for (; i + 16 <= rowSize; i += 16) {
+      uint64_t first;
+      uint64_t second;
+      memcpy(&first, row + i, 8);
+      memcpy(&second, row + i + 8, 8);
+      a = _mm_crc32_u64(a, first);
+      b = _mm_crc32_u64(b, second);
+    }
+    for (; i + 4 <= rowSize; i += 4) {
+      uint32_t pixel;
+      memcpy(&pixel, row + i, 4);
+      a = _mm_crc32_u32(static_cast<uint32_t>(a), pixel);
+    }
+  }
+  return a << 32 | (b & 0xFFFFFFFF);
+}
+#endif
+
+uint64_t HashRowsScalar(const uint8_t* source,
+                        size_t sourceStride,
+                        size_t rowSize,
+                        int rows) {
+  uint64_t hash = 14695981039346656037ull;
+  for (int y = 0; y < rows; ++y) {
+    const uint8_t* row = source + y * sourceStride;
+    for (size_t i = 0; i + 4 <= rowSize; i += 4) {
+      uint32_t pixel;
+      memcpy(&pixel, row + i, 4);
+      hash = (hash ^ pixel) * 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+// Swaps the B and R bytes of each pixel.
+inline uint32_t SwapRedBlue(uint32_t pixel) {
+  return (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) |
+         ((pixel & 0xFF) << 16);
+}
+
+#if defined(PIXEL_OPS_SSE2)
+inline __m128i SwapRedBlue(__m128i pixels) {
+  const __m128i greenAlpha = _mm_set1_epi32(0xFF00FF00);
+  const __m128i low = _mm_set1_epi32(0xFF);
+  __m128i red = _mm_and_si128(_mm_srli_epi32(pixels, 16), low);
+  __m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, low), 16);
+  return _mm_or_si128(_mm_and_si128(pixels, greenAlpha),
+                      _mm_or_si128(red, blue));
+}
+#endif
+
+#if defined(PIXEL_OPS_AVX2)
+PIXEL_OPS_TARGET_AVX2
+void SwapRedBlueRowAvx2(uint8_t* row, int pixels) {
+  const __m256i shuffle = _mm256_setr_epi8(
+      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0, 3, 6, 5,
+      4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  int x = 0;
+  for (; x + 8 <= pixels; x += 8) {
+    __m256i* p = reinterpret_cast<__m256i*>(row + x * 4);
+    _mm256_storeu_si256(p,
+                        _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+  }
+  for (; x < pixels; ++x) {
+    uint32_t pixel;
+    memcpy(&pixel, row + x * 4, 4);
+    pixel = SwapRedBlue(pixel);
+    memcpy(row + x * 4, &pixel, 4);
+  }
+}
+#endif
+
+void SwapRedBlueRow(uint8_t* row, int pixels) {
+#if defined(PIXEL_OPS_AVX2)
+  static const bool hasAvx2 = HasAvx2();
+  if (hasAvx2) {
+    SwapRedBlueRowAvx2(row, pixels);
+    return;
+  }
+#endif
+  int x = 0;
+#if defined(PIXEL_OPS_SSE2)
+  for (; x + 4 <= pixels; x += 4) {
+    __m128i* p = reinterpret_cast<__m128i*>(row + x * 4);
+    _mm_storeu_si128(p, SwapRedBlue(_mm_loadu_si128(p)));
+  }
+#endif
+  for (; x < pixels; ++x) {
+    uint32_t pixel;
+    memcpy(&pixel, row + x * 4, 4);
+    pixel = SwapRedBlue(pixel);
+    memcpy(row + x * 4, &pixel, 4);
+  }
+}
+
+// 255 * 65536 / alpha, so that a channel is unpremultiplied with a multiply
+// and a shift.
+struct UnpremultiplyTable {
+  uint32_t factors[256];
+
+  UnpremultiplyTable() {
+    factors[0] = 0;
+    for (uint32_t alpha = 1; alpha < 256; ++alpha) {
+      factors[alpha] = (255 * 65536 + alpha / 2) / alpha;
+    }
+  }
+};
+
+// Runs of opaque pixels, the common case for web content, are skipped four
+// at a time.
+void UnpremultiplyRow(uint8_t* row, int pixels) {
+  static const UnpremultiplyTable table;
+  int x = 0;
+  while (x < pixels) {
+#if defined(PIXEL_OPS_SSE2)
+    const __m128i alphaMask = _mm_set1_epi32(0xFF000000);
+    while (x + 4 <= pixels) {
+      __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i*>(row + x * 4));
+      __m128i alpha = _mm_and_si128(p, alphaMask);
+      if (_mm_movemask_epi8(_mm_cmpeq_epi32(alpha, alphaMask)) != 0xFFFF) {
+        break;
+      }
+      x += 4;
+    }
+    if (x >= pixels) {
+      break;
+    }
+#endif
+    uint8_t* pixel = row + x * 4;
+    uint32_t alpha = pixel[3];
+    if (alpha != 255) {
+      uint32_t factor = table.factors[alpha];
+      for (int channel = 0; channel < 3; ++channel) {
+        uint32_t value = (pixel[channel] * factor + 32768) >> 16;
+        pixel[channel] = static_cast<uint8_t>(std::min(value, 255u));
+      }
+    }
+    ++x;
+  }
+}
+
+// Averages each 2x2 block of |top| and |bottom| into one pixel of
+// |destination|, rounding half up. A missing last column or row repeats the
+// previous one.
+void DownscaleRow(uint8_t* destination,
+                  const uint8_t* top,
+                  const uint8_t* bottom,
+                  int sourceX,
+                  int sourceWidth,
+                  int pixels) {
+  int x = 0;
+#if defined(PIXEL_OPS_SSE2)
+  // Eight source pixels per row become four output pixels. The channels are
+  // summed as 16-bit values, so the result matches the scalar loop exactly;
+  // chaining _mm_avg_epu8 would round up twice.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i two = _mm_set1_epi16(2);
+  for (; x + 4 <= pixels && sourceX + (x + 4) * 2 <= sourceWidth; x += 4) {
+    size_t offset = static_cast<size_t>(sourceX + x * 2) * 4;
+    __m128i a0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + offset));
+    __m128i a1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(top + offset + 16));
+    __m128i b0 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + offset));
+    __m128i b1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + offset + 16));
+    // Column sums of source pixels 0-1, 2-3, 4-5 and 6-7.
+    __m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero),
+                                _mm_unpacklo_epi8(b0, zero));
+    __m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero),
+                                _mm_unpackhi_epi8(b0, zero));
+    __m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero),
+                                _mm_unpacklo_epi8(b1, zero));
+    __m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero),
+                                _mm_unpackhi_epi8(b1, zero));
+    // Add each even source pixel to the odd one after it.
+    __m128i out01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23),
+                                  _mm_unpackhi_epi64(s01, s23));
+    __m128i out23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67),
+                                  _mm_unpackhi_epi64(s45, s67));
+    out01 = _mm_srli_epi16(_mm_add_epi16(out01, two), 2);
+    out23 = _mm_srli_epi16(_mm_add_epi16(out23, two), 2);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + x * 4),
+                     _mm_packus_epi16(out01, out23));
+  }
+#endif
+  for (; x < pixels; ++x) {
+    int left = sourceX + x * 2;
+    int right = std::min(left + 1, sourceWidth - 1);
+    for (int channel = 0; channel < 4; ++channel) {
+      int sum = top[left * 4 + channel] + top[right * 4 + channel] +
+                bottom[left * 4 + channel] + bottom[right * 4 + channel];
+      destination[x * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+    }
+  }
+}
+
+bool Intersects(const CefRect& a, const CefRect& b) {
+  return a.x < b.x + b.width && b.x < a.x + a.width && a.y < b.y + b.height &&
+         b.y < a.y + a.height;
+}
+
+CefRect Union(const CefRect& a, const CefRect& b) {
+  int left = std::min(a.x, b.x);
+  int top = std::min(a.y, b.y);
+  int right = std::max(a.x + a.width, b.x + b.width);
+  int bottom = std::max(a.y + a.height, b.y + b.height);
+  return CefRect(left, top, right - left, bottom - top);
+}
+
+}  // namespace
+
+void CopyPixelRect(uint8_t* destination,
+                   size_t destinationStride,
+                   const uint8_t* source,
+                   size_t sourceStride,
+                   const CefRect& rect) {
+  size_t rowSize = static_cast<size_t>(rect.width) * 4;
+  size_t offsetX = static_cast<size_t>(rect.x) * 4;
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    CopyRow(destination + y * destinationStride + offsetX,
+            source + y * sourceStride + offsetX, rowSize);
+  }
+}
+
+int ScaledPixelSize(int size, const PixelConversion& conversion) {
+  return (size + conversion.scaleDivisor - 1) / conversion.scaleDivisor;
+}
+
+CefRect ScalePixelRect(const CefRect& rect,
+                       const PixelConversion& conversion) {
+  int divisor = conversion.scaleDivisor;
+  int left = rect.x / divisor;
+  int top = rect.y / divisor;
+  int right = (rect.x + rect.width + divisor - 1) / divisor;
+  int bottom = (rect.y + rect.height + divisor - 1) / divisor;
+  return CefRect(left, top, right - left, bottom - top);
+}
+
+void ConvertPixelRect(uint8_t* destination,
+                      size_t destinationStride,
+                      const uint8_t* source,
+                      size_t sourceStride,
+                      int sourceWidth,
+                      int sourceHeight,
+                      const CefRect& rect,
+                      const PixelConversion& conversion) {
+  if (conversion.IsIdentity()) {
+    CopyPixelRect(destination, destinationStride, source, sourceStride, rect);
+    return;
+  }
+  size_t rowSize = static_cast<size_t>(rect.width) * 4;
+  size_t offsetX = static_cast<size_t>(rect.x) * 4;
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    // The row is converted in place right after being written, while it is
+    // still in cache.
+    uint8_t* row = destination + y * destinationStride + offsetX;
+    if (conversion.scaleDivisor == 2) {
+      int sourceY = y * 2;
+      int nextY = std::min(sourceY + 1, sourceHeight - 1);
+      DownscaleRow(row, source + sourceY * sourceStride,
+                   source + nextY * sourceStride, rect.x * 2, sourceWidth,
+                   rect.width);
+    } else {
+      CopyRow(row, source + y * sourceStride + offsetX, rowSize);
+    }
+    if (conversion.unpremultiply) {
+      UnpremultiplyRow(row, rect.width);
+    }
+    if (conversion.format == PixelFormat::Rgba) {
+      SwapRedBlueRow(row, rect.width);
+    }
+  }
+}
+
+uint64_t HashPixelRect(const uint8_t* source,
+                       size_t sourceStride,
+                       const CefRect& rect) {
+  const uint8_t* origin =
+      source + rect.y * sourceStride + static_cast<size_t>(rect.x) * 4;
+  size_t rowSize = static_cast<size_t>(rect.width) * 4;
+#if defined(PIXEL_OPS_CRC32)
+  static const bool hasSse42 = HasSse42();
+  if (hasSse42) {
+    return HashRowsCrc32(origin, sourceStride, rowSize, rect.height);
+  }
+#endif
+  return HashRowsScalar(origin, sourceStride, rowSize, rect.height);
+}
+
+std::vector<CefRect> MergeDirtyRects(const std::vector<CefRect>& rects,
+                                     const CefRect& bounds) {
+  std::vector<CefRect> merged;
+  for (CefRect rect : rects) {
+    int left = std::max(rect.x, bounds.x);
+    int top = std::max(rect.y, bounds.y);
+    int right = std::min(rect.x + rect.width, bounds.x + bounds.width);
+    int bottom = std::min(rect.y + rect.height, bounds.y + bounds.height);
+    if (right <= left || bottom <= top) {
+      continue;
+    }
+    rect = CefRect(left, top, right - left, bottom - top);
+
+    // Absorb every rectangle the new one overlaps; the result may overlap
+    // others that were disjoint before, so repeat until it does not.
+    bool grew = true;
+    while (grew) {
+      grew = false;
+      for (size_t i = 0; i < merged.size(); ++i) {
+        if (Intersects(rect, merged[i])) {
+          rect = Union(rect, merged[i]);
+          merged.erase(merged.begin() + i);
+          grew = true;
+          break;
+        }
+      }
+    }
+    merged.push_back(rect);
+  }
+  return merged;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "include/internal/cef_types_wrappers.h"
+
+// Pixel routines for the OnPaint path. All buffers are 32 bits per pixel.
+
+// Layout of paint surfaces as seen by the client. CEF paints BGRA with
+// premultiplied alpha.
+enum class PixelFormat {
+  Bgra = 0,
+  Rgba = 1,
+};
+
+struct PixelConversion {
+  PixelFormat format = PixelFormat::Bgra;
+  bool unpremultiply = false;
+  // 1 or 2. A divisor of 2 averages each 2x2 block into one pixel.
+  int scaleDivisor = 1;
+
+  bool IsIdentity() const {
+    return format == PixelFormat::Bgra && !unpremultiply && scaleDivisor == 1;
+  }
+};
+
+// Copies |rect| from |source| to the same position in |destination|, one row
+// at a time with SSE2 where available.
+void CopyPixelRect(uint8_t* destination,
+                   size_t destinationStride,
+                   const uint8_t* source,
+                   size_t sourceStride,
+                   const CefRect& rect);
+
+// Size of the output of |conversion| for a source of |size| pixels.
+int ScaledPixelSize(int size, const PixelConversion& conversion);
+
+// The smallest output rectangle covering source rectangle |rect|.
+CefRect ScalePixelRect(const CefRect& rect, const PixelConversion& conversion);
+
+// Produces output rectangle |rect| of |destination| from a |sourceWidth| x
+// |sourceHeight| source, downscaling and converting in the same pass over
+// each row. Uses SSE2, and AVX2 where the CPU has it, with scalar fallbacks.
+void ConvertPixelRect(uint8_t* destination,
+                      size_t destinationStride,
+                      const uint8_t* source,
+                      size_t sourceStride,
+                      int sourceWidth,
+                      int sourceHeight,
+                      const CefRect& rect,
+                      const PixelConversion& conversion);
+
+// Hashes the pixels of |rect|, with the SSE4.2 CRC32 instruction where the
+// CPU has it. Only meant for comparing a region against itself over time.
+uint64_t HashPixelRect(const uint8_t* source,
+                       size_t sourceStride,
+                       const CefRect& rect);
+
+// Clips |rects| to |bounds| and merges overlapping rectangles into their
+// bounding box, so that no pixel is copied twice.
+std::vector<CefRect> MergeDirtyRects(const std::vector<CefRect>& rects,
+                                     const CefRect& bounds);
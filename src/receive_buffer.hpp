@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Growable receive buffer for length-prefixed RPC frames.
+//
+// Socket reads land directly in the free tail of the buffer and complete
+// frames are handed out as spans into it, so a frame is never copied or
+// shifted on its own. Consumed bytes are reclaimed lazily: the unread
+// remainder is moved to the front only when the tail runs out of room.
+class ReceiveBuffer {
+ public:
+  static constexpr size_t kFrameHeaderSize = 4;
+
+  enum class FrameStatus {
+    Incomplete,
+    Ready,
+    TooLarge,
+  };
+
+  ReceiveBuffer(size_t initialCapacity, uint32_t maxFrameSize)
+      : buffer(initialCapacity),
+        initialCapacity(initialCapacity),
+        maxFrameSize(maxFrameSize) {}
+
+  // Returns the writable tail of the buffer, making sure at least
+  // |minimumSize| bytes (or the remainder of a partially received frame,
+  // whichever is larger) are available. Spans previously returned by
+  // NextFrame() are invalidated.
+  uint8_t* PrepareWrite(size_t minimumSize, size_t& available) {
+    if (readOffset == writeOffset) {
+      readOffset = 0;
+      writeOffset = 0;
+      if (buffer.size() > 4 * initialCapacity) {
+        std::vector<uint8_t>(initialCapacity).swap(buffer);
+      }
+    }
+
+    size_t required = minimumSize;
+    if (pendingFrameSize > 0) {
+      size_t unread = writeOffset - readOffset;
+      size_t frameRemainder = kFrameHeaderSize + pendingFrameSize - unread;
+      if (frameRemainder > required) {
+        required = frameRemainder;
+      }
+    }
+
+    if (buffer.size() - writeOffset < required) {
+      size_t unread = writeOffset - readOffset;
+      if (readOffset > 0) {
+        memmove(buffer.data(), buffer.data() + readOffset, unread);
+        readOffset = 0;
+        writeOffset = unread;
+      }
+      if (buffer.size() - writeOffset < required) {
+        size_t capacity = buffer.size() * 2;
+        if (capacity < writeOffset + required) {
+          capacity = writeOffset + required;
+        }
+        buffer.resize(capacity);
+      }
+    }
+
+    available = buffer.size() - writeOffset;
+    return buffer.data() + writeOffset;
+  }
+
+  // Marks |size| bytes written into the region returned by PrepareWrite().
+  void CommitWrite(size_t size) { writeOffset += size; }
+
+  // Extracts the next complete frame. On Ready, |data| points into the buffer
+  // and stays valid until the next PrepareWrite() call.
+  FrameStatus NextFrame(const uint8_t*& data, uint32_t& size) {
+    size_t unread = writeOffset - readOffset;
+    if (unread < kFrameHeaderSize) {
+      return FrameStatus::Incomplete;
+    }
+
+    uint32_t frameSize;
+    memcpy(&frameSize, buffer.data() + readOffset, kFrameHeaderSize);
+    if (frameSize > maxFrameSize) {
+      return FrameStatus::TooLarge;
+    }
+    if (unread < kFrameHeaderSize + frameSize) {
+      pendingFrameSize = frameSize;
+      return FrameStatus::Incomplete;
+    }
+
+    pendingFrameSize = 0;
+    data = buffer.data() + readOffset + kFrameHeaderSize;
+    size = frameSize;
+    readOffset += kFrameHeaderSize + frameSize;
+    return FrameStatus::Ready;
+  }
+
+ private:
+  std::vector<uint8_t> buffer;
+  size_t initialCapacity;
+  uint32_t maxFrameSize;
+  size_t readOffset = 0;
+  size_t writeOffset = 0;
+  uint32_t pendingFrameSize = 0;
+};
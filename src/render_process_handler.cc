@@ -62,9 +62,8 @@ class MouseOverHandler : public CefV8Handler {
       CefRefPtr<CefV8Value> target = event->GetValue("target");
 
       RpcRequest request;
-      request.id = CreateUuid();
-      request.className = "Browser";
-      request.methodName = "OnMouseOver";
+      request.id = NextRpcId();
+      request.method = RpcMethodId::Browser_OnMouseOver;
       request.instanceId = frame->GetBrowser()->GetIdentifier();
       Browser_OnMouseOver mouseOverArguments;
       mouseOverArguments.tagName =
@@ -169,19 +168,18 @@ class HistoryHandler : public CefV8Handler {
       CefRefPtr<CefFrame> frame = context->GetFrame();
 
       RpcRequest request;
-      request.id = CreateUuid();
-      request.className = "Browser";
+      request.id = NextRpcId();
       request.instanceId = frame->GetBrowser()->GetIdentifier();
       std::string action = arguments[0]->GetStringValue().ToString();
 
       if (action == "pushState") {
-        request.methodName = "OnPushState";  
+        request.method = RpcMethodId::Browser_OnPushState;  
         Browser_OnPushState args;
         args.state = arguments[1]->GetStringValue().ToString();
         args.url = arguments[2]->GetStringValue().ToString();
         request.arguments = args;
       } else if (action == "replaceState") {
-        request.methodName = "OnReplaceState";
+        request.method = RpcMethodId::Browser_OnReplaceState;
         Browser_OnReplaceState args;
         args.state = arguments[1]->GetStringValue().ToString();
         args.url = arguments[2]->GetStringValue().ToString();
@@ -214,13 +212,12 @@ class NavigationHandler : public CefV8Handler {
       CefRefPtr<CefFrame> frame = context->GetFrame();
 
       RpcRequest request;
-      request.id = CreateUuid();
-      request.className = "Browser";
+      request.id = NextRpcId();
       request.instanceId = frame->GetBrowser()->GetIdentifier();
       std::string action = arguments[0]->GetStringValue().ToString();
 
       if (action == "url") {
-        request.methodName = "OnNavigateByUrl";
+        request.method = RpcMethodId::Browser_OnNavigateByUrl;
         Browser_OnNavigateByUrl args;
         args.url = arguments[1]->GetStringValue().ToString();
         args.state = arguments[2]->GetStringValue().ToString();
@@ -228,13 +225,13 @@ class NavigationHandler : public CefV8Handler {
         args.history = arguments[4]->GetStringValue().ToString();
         request.arguments = args;
       } else if (action == "delta") {
-        request.methodName = "OnNavigateByDelta";
+        request.method = RpcMethodId::Browser_OnNavigateByDelta;
         Browser_OnNavigateByDelta args;
         args.delta = arguments[1]->GetIntValue();
         args.info = arguments[2]->GetStringValue().ToString();
         request.arguments = args;
       } else if (action == "key") {
-        request.methodName = "OnNavigateByKey";
+        request.method = RpcMethodId::Browser_OnNavigateByKey;
         Browser_OnNavigateByKey args;
         args.key = arguments[1]->GetStringValue().ToString();
         args.info = arguments[2]->GetStringValue().ToString();
@@ -269,9 +266,8 @@ class FocusOutHandler : public CefV8Handler {
       CefRefPtr<CefV8Value> relatedTarget = event->GetValue("relatedTarget");
 
       RpcRequest request;
-      request.id = CreateUuid();
-      request.className = "Browser";
-      request.methodName = "OnFocusOut";
+      request.id = NextRpcId();
+      request.method = RpcMethodId::Browser_OnFocusOut;
       request.instanceId = frame->GetBrowser()->GetIdentifier();
       Browser_FocusOut focusOutArguments;
       if (!relatedTarget->IsNull()) {
@@ -315,9 +311,8 @@ class ConsoleHandler : public CefV8Handler {
     CefRefPtr<CefV8Value> stringifyFn = jsonObj->GetValue("stringify");
 
     RpcRequest request;
-    request.id = CreateUuid();
-    request.className = "Browser";
-    request.methodName = "OnConsoleMessage";
+    request.id = NextRpcId();
+    request.method = RpcMethodId::Browser_OnConsoleMessage;
     request.instanceId = frame->GetBrowser()->GetIdentifier();
     Browser_OnConsoleMessage args;
     args.level = name == "error" ? LOGSEVERITY_ERROR
@@ -500,9 +495,8 @@ void RenderProcessHandler::OnFocusedNodeChanged(CefRefPtr<CefBrowser> browser,
                                                 CefRefPtr<CefDOMNode> node) {
   if (node.get()) {
     RpcRequest request;
-    request.id = CreateUuid();
-    request.className = "Browser";
-    request.methodName = "OnFocusedNodeChanged";
+    request.id = NextRpcId();
+    request.method = RpcMethodId::Browser_OnFocusedNodeChanged;
     request.instanceId = browser->GetIdentifier();
     Browser_OnFocusedNodeChanged focusedNodeArguments;
     focusedNodeArguments.tagName = node->GetElementTagName();
@@ -525,7 +519,7 @@ class PromiseThenHandler : public CefV8Handler {
  public:
   explicit PromiseThenHandler(CefRefPtr<CefFrame> frame,
                               CefProcessId sourceProcessId,
-                              const UUID messageId)
+                              const RpcId messageId)
       : frame(frame), sourceProcessId(sourceProcessId), messageId(messageId) {}
 
   bool Execute(const CefString& name,
@@ -563,7 +557,7 @@ class PromiseThenHandler : public CefV8Handler {
  private:
   CefRefPtr<CefFrame> frame;
   CefProcessId sourceProcessId;
-  const UUID messageId;
+  const RpcId messageId;
   IMPLEMENT_REFCOUNTING(PromiseThenHandler);
 };
 
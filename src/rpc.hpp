@@ -1,11 +1,14 @@
 #pragma once
 
 #include <rpc.h>
+#include <map>
 #include <optional>
 #include <string>
 #include <variant>
 #include "include/internal/cef_types_wrappers.h"
 #include "json.hpp"
+#include "rpc_id.hpp"
+#include "rpc_methods.hpp"
 
 using json = nlohmann::json;
 
@@ -31,40 +34,6 @@ inline void from_json(const json& j, HANDLE& m) {
   m = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(v));
 }
 
-// UUID
-inline UUID CreateUuid() {
-  UUID uuid;
-  RPC_STATUS resultCode = UuidCreate(&uuid);
-  if (resultCode == RPC_S_OK) {
-    return uuid;
-  } else {
-    throw std::runtime_error("UuidCreate() failed with error code: " +
-                             std::to_string(resultCode));
-  }
-}
-
-inline void to_json(json& j, const UUID& m) {
-  RPC_CSTR str;
-  RPC_STATUS resultCode = UuidToStringA(const_cast<UUID*>(&m), &str);
-  if (resultCode == RPC_S_OK) {
-    j = std::string(reinterpret_cast<char*>(str));
-    RpcStringFreeA(&str);
-  } else {
-    throw std::runtime_error("UuidToStringA() failed with error code: " +
-                             std::to_string(resultCode));
-  }
-}
-
-inline void from_json(const json& j, UUID& m) {
-  std::string str = j.get<std::string>();
-  RPC_CSTR rpcStr = reinterpret_cast<RPC_CSTR>(const_cast<char*>(str.c_str()));
-  RPC_STATUS resultCode = UuidFromStringA(rpcStr, &m);
-  if (resultCode != RPC_S_OK) {
-    throw std::runtime_error("UuidFromStringA() failed with error code: " +
-                             std::to_string(resultCode));
-  }
-}
-
 // CEF types
 inline void to_json(json& j, const CefRect& m) {
   j = json::object();
@@ -126,33 +95,65 @@ inline void from_json(const json& j, CefKeyEvent& m) {
   j.at("focus_on_editable_field").get_to(m.focus_on_editable_field);
 }
 
+inline void from_json(const json& j, CefTouchEvent& m) {
+  j.at("id").get_to(m.id);
+  j.at("x").get_to(m.x);
+  j.at("y").get_to(m.y);
+  j.at("radius_x").get_to(m.radius_x);
+  j.at("radius_y").get_to(m.radius_y);
+  j.at("rotation_angle").get_to(m.rotation_angle);
+  j.at("pressure").get_to(m.pressure);
+  j.at("type").get_to(m.type);
+  j.at("modifiers").get_to(m.modifiers);
+  j.at("pointer_type").get_to(m.pointer_type);
+}
+
 // Request messages
 struct RpcRequest {
-  UUID id;
-  std::string className;
-  std::string methodName;
+  RpcId id;
+  RpcMethodId method = RpcMethodId::Unknown;
   int instanceId;
   json arguments;
 };
 
+// Requests name their method either by "methodId" or by "class" and
+// "method"; the id wins when both are present. Unknown methods are left as
+// RpcMethodId::Unknown for the caller to report.
 inline void from_json(const json& j, RpcRequest& m) {
   j.at("id").get_to(m.id);
-  j.at("class").get_to(m.className);
-  j.at("method").get_to(m.methodName);
+  m.method = RpcMethodId::Unknown;
+  auto methodId = j.find("methodId");
+  if (methodId != j.end() && methodId->is_number_unsigned()) {
+    if (const RpcMethodInfo* info =
+            FindRpcMethod(methodId->get<uint32_t>())) {
+      m.method = info->id;
+    }
+  } else {
+    const auto& className = j.at("class").get_ref<const std::string&>();
+    const auto& methodName = j.at("method").get_ref<const std::string&>();
+    if (const RpcMethodInfo* info = FindRpcMethod(className, methodName)) {
+      m.method = info->id;
+    }
+  }
   j.at("instanceId").get_to(m.instanceId);
   j.at("arguments").get_to(m.arguments);
 }
 
 inline void to_json(json& j, const RpcRequest& m) {
+  const RpcMethodInfo& info = GetRpcMethodInfo(m.method);
   j = json::object();
   j["id"] = m.id;
-  j["class"] = m.className;
-  j["method"] = m.methodName;
+  j["class"] = std::string(info.className);
+  j["method"] = std::string(info.methodName);
+  j["methodId"] = static_cast<uint16_t>(info.id);
   j["instanceId"] = m.instanceId;
   j["arguments"] = m.arguments;
 }
 
 // Response messages
+// |externalBeginFrame| makes a windowless browser produce frames only when
+// the client sends Browser.BeginFrame or Client.BeginFrames. Null or absent
+// uses the --external-begin-frame-enabled switch of the runner.
 struct Client_CreateBrowser {
   std::string url;
   CefRect rectangle;
@@ -160,6 +161,7 @@ struct Client_CreateBrowser {
   uintptr_t parentWindowHandle;
   bool windowless;
   bool hardwareAccelerated;
+  std::optional<bool> externalBeginFrame;
 };
 
 inline void from_json(const json& j, Client_CreateBrowser& m) {
@@ -169,6 +171,41 @@ inline void from_json(const json& j, Client_CreateBrowser& m) {
   j.at("parentWindowHandle").get_to(m.parentWindowHandle);
   j.at("windowless").get_to(m.windowless);
   j.at("hardwareAccelerated").get_to(m.hardwareAccelerated);
+  // Optional, for clients predating the key.
+  if (j.contains("externalBeginFrame")) {
+    j.at("externalBeginFrame").get_to(m.externalBeginFrame);
+  }
+}
+
+// Begin frames for several browsers in one message, e.g. once per vsync of
+// the client.
+struct Client_BeginFrames {
+  std::vector<int> browserIds;
+};
+
+inline void from_json(const json& j, Client_BeginFrames& m) {
+  j.at("browserIds").get_to(m.browserIds);
+}
+
+struct Client_Handshake {
+  std::string encoding;
+};
+
+inline void from_json(const json& j, Client_Handshake& m) {
+  j.at("encoding").get_to(m.encoding);
+}
+
+// Response deadlines for requests the runner blocks on, in milliseconds.
+// Keys of |methodTimeoutsMs| are "Class.Method" of messages the runner
+// sends; 0 waits forever. A call with an invalid key changes nothing.
+struct Client_SetResponseTimeouts {
+  std::optional<uint32_t> defaultTimeoutMs;
+  std::map<std::string, uint32_t> methodTimeoutsMs;
+};
+
+inline void from_json(const json& j, Client_SetResponseTimeouts& m) {
+  j.at("defaultTimeoutMs").get_to(m.defaultTimeoutMs);
+  j.at("methodTimeoutsMs").get_to(m.methodTimeoutsMs);
 }
 
 struct Browser_EvalJavaScript {
@@ -227,6 +264,50 @@ inline void from_json(const json& j, Browser_OnKeyboardEvent& m) {
   j.at("event").get_to(m.event);
 }
 
+struct Browser_OnTouchEvent {
+  CefTouchEvent event;
+};
+
+inline void from_json(const json& j, Browser_OnTouchEvent& m) {
+  j.at("event").get_to(m.event);
+}
+
+// One entry of Browser.SendInputBatch: |type| is "mouseClick", "mouseMove",
+// "mouseWheel", "key" or "touch", next to the arguments of the matching
+// single-event request.
+using Browser_InputEvent = std::variant<Browser_OnMouseClick,
+                                        Browser_OnMouseMove,
+                                        Browser_OnMouseWheel,
+                                        Browser_OnKeyboardEvent,
+                                        Browser_OnTouchEvent>;
+
+inline void from_json(const json& j, Browser_InputEvent& m) {
+  const auto& type = j.at("type").get_ref<const std::string&>();
+  if (type == "mouseClick") {
+    m = j.get<Browser_OnMouseClick>();
+  } else if (type == "mouseMove") {
+    m = j.get<Browser_OnMouseMove>();
+  } else if (type == "mouseWheel") {
+    m = j.get<Browser_OnMouseWheel>();
+  } else if (type == "key") {
+    m = j.get<Browser_OnKeyboardEvent>();
+  } else if (type == "touch") {
+    m = j.get<Browser_OnTouchEvent>();
+  } else {
+    throw json::other_error::create(501, "unknown input event type " + type,
+                                    &j);
+  }
+}
+
+// Input gathered by the client over one frame, applied in order.
+struct Browser_SendInputBatch {
+  std::vector<Browser_InputEvent> events;
+};
+
+inline void from_json(const json& j, Browser_SendInputBatch& m) {
+  j.at("events").get_to(m.events);
+}
+
 struct Browser_OnMouseOver {
   std::string tagName;
   std::optional<std::string> inputType;
@@ -257,7 +338,7 @@ inline void to_json(json& j, const Browser_FocusOut& m) {
 
 // Response messages
 struct RpcResponse {
-  UUID requestId;
+  RpcId requestId;
   bool success;
   json returnValue;
   json error;
@@ -334,7 +415,13 @@ struct PostDataElement {
 inline void from_json(const json& j, PostDataElement& m) {
   j.at("type").get_to(m.type);
   j.at("fileName").get_to(m.fileName);
-  j.at("bytes").get_to(m.bytes);
+  const json& bytes = j.at("bytes");
+  if (bytes.is_binary()) {
+    m.bytes = std::vector<uint8_t>(bytes.get_binary().begin(),
+                                   bytes.get_binary().end());
+  } else {
+    bytes.get_to(m.bytes);
+  }
 }
 
 struct Browser_LoadRequest {
@@ -359,6 +446,96 @@ inline void from_json(const json& j, Browser_SetFrameRate& m) {
   j.at("frameRate").get_to(m.frameRate);
 }
 
+// Share of the send thread this browser gets relative to the others when
+// several have messages queued, 1 to 16. Browsers start at 1; raise the
+// focused one so a busy background page cannot delay it.
+struct Browser_SetSendWeight {
+  int weight;
+};
+
+inline void from_json(const json& j, Browser_SetSendWeight& m) {
+  j.at("weight").get_to(m.weight);
+}
+
+// Lets the runner lower the frame rate of a hidden, idle or lagging browser
+// and raise it again on input or animation, within these bounds. Null bounds
+// turn the governor off and leave the frame rate where it is.
+struct Browser_SetFrameRateBounds {
+  std::optional<int> minFrameRate;
+  std::optional<int> maxFrameRate;
+};
+
+inline void from_json(const json& j, Browser_SetFrameRateBounds& m) {
+  j.at("minFrameRate").get_to(m.minFrameRate);
+  j.at("maxFrameRate").get_to(m.maxFrameRate);
+}
+
+// View geometry pushed by the client. |screenOrigin| is the screen position
+// of the view's top-left corner in device pixels. |screenRect| and
+// |availableScreenRect| are the bounds of the monitor showing the view and
+// of its work area, in DIPs; CEF falls back to its own idea of the screen
+// without them.
+struct Browser_SetGeometry {
+  CefRect viewRect;
+  CefPoint screenOrigin;
+  float deviceScaleFactor;
+  std::optional<CefRect> screenRect;
+  std::optional<CefRect> availableScreenRect;
+};
+
+inline void from_json(const json& j, Browser_SetGeometry& m) {
+  j.at("viewRect").get_to(m.viewRect);
+  j.at("screenOrigin").get_to(m.screenOrigin);
+  j.at("deviceScaleFactor").get_to(m.deviceScaleFactor);
+  // Optional, for clients predating the keys.
+  if (j.contains("screenRect")) {
+    j.at("screenRect").get_to(m.screenRect);
+  }
+  if (j.contains("availableScreenRect")) {
+    j.at("availableScreenRect").get_to(m.availableScreenRect);
+  }
+}
+
+// Paint delivery options. A |bufferCount| above 1 stops OnPaint from
+// waiting for the client: frames rotate through that many surfaces and the
+// client hands each one back with Browser.PaintAck. |detectUnchangedTiles|
+// hashes the reported dirty regions and drops the parts, or whole frames,
+// whose pixels did not actually change. |pixelFormat| (0 BGRA, 1 RGBA),
+// |premultipliedAlpha| and |scaleDivisor| (1 or 2) select the layout the
+// surfaces are written in; changing them starts a new surface generation.
+// |compositePopups| draws popup widgets into the view surfaces instead of
+// sending popup frames and OnPopupShow/OnPopupSize. Null leaves an option as
+// it is.
+struct Browser_SetPaintOptions {
+  std::optional<int> bufferCount;
+  std::optional<bool> detectUnchangedTiles;
+  std::optional<int> pixelFormat;
+  std::optional<bool> premultipliedAlpha;
+  std::optional<int> scaleDivisor;
+  std::optional<bool> compositePopups;
+};
+
+inline void from_json(const json& j, Browser_SetPaintOptions& m) {
+  j.at("bufferCount").get_to(m.bufferCount);
+  j.at("detectUnchangedTiles").get_to(m.detectUnchangedTiles);
+  j.at("pixelFormat").get_to(m.pixelFormat);
+  j.at("premultipliedAlpha").get_to(m.premultipliedAlpha);
+  j.at("scaleDivisor").get_to(m.scaleDivisor);
+  j.at("compositePopups").get_to(m.compositePopups);
+}
+
+struct Browser_PaintAck {
+  int elementType;
+  uint32_t generation;
+  int bufferIndex;
+};
+
+inline void from_json(const json& j, Browser_PaintAck& m) {
+  j.at("elementType").get_to(m.elementType);
+  j.at("generation").get_to(m.generation);
+  j.at("bufferIndex").get_to(m.bufferIndex);
+}
+
 struct Browser_OnAcceleratedPaint {
   int elementType;
   uintptr_t sharedTextureHandle;
@@ -670,13 +847,54 @@ inline void to_json(json& j, const Browser_OnTooltip& m) {
   j["text"] = m.text;
 }
 
+struct Browser_PaintSurface {
+  uintptr_t sharedMemoryHandle;
+  size_t sharedMemorySize;
+};
+
+inline void to_json(json& j, const Browser_PaintSurface& m) {
+  j = json::object();
+  j["sharedMemoryHandle"] = m.sharedMemoryHandle;
+  j["sharedMemorySize"] = m.sharedMemorySize;
+}
+
+// Sent whenever the paint surfaces of an element type are (re)allocated,
+// before the first OnPaint that uses them. Handles of earlier generations
+// for the same element type are no longer written to and should be closed.
+struct Browser_OnPaintSurfaceCreated {
+  int elementType;
+  uint32_t generation;
+  int width;
+  int height;
+  int stride;
+  int pixelFormat;
+  bool premultipliedAlpha;
+  std::vector<Browser_PaintSurface> surfaces;
+};
+
+inline void to_json(json& j, const Browser_OnPaintSurfaceCreated& m) {
+  j = json::object();
+  j["elementType"] = m.elementType;
+  j["generation"] = m.generation;
+  j["width"] = m.width;
+  j["height"] = m.height;
+  j["stride"] = m.stride;
+  j["pixelFormat"] = m.pixelFormat;
+  j["premultipliedAlpha"] = m.premultipliedAlpha;
+  j["surfaces"] = m.surfaces;
+}
+
+// |dirtyRects| are the regions of surface |bufferIndex| rewritten for this
+// frame; with several surfaces they also cover what changed while the
+// surface was not being written. Pipelined frames must be returned with
+// Browser.PaintAck once the client no longer reads the surface.
 struct Browser_OnPaint {
   int elementType;
   int width;
   int height;
   std::vector<CefRect> dirtyRects;
-  uintptr_t sharedMemoryHandle;
-  int sharedMemorySize;
+  int bufferIndex;
+  uint32_t generation;
 };
 
 inline void to_json(json& j, const Browser_OnPaint& m) {
@@ -685,8 +903,8 @@ inline void to_json(json& j, const Browser_OnPaint& m) {
   j["width"] = m.width;
   j["height"] = m.height;
   j["dirtyRects"] = m.dirtyRects;
-  j["sharedMemoryHandle"] = m.sharedMemoryHandle;
-  j["sharedMemorySize"] = m.sharedMemorySize;
+  j["bufferIndex"] = m.bufferIndex;
+  j["generation"] = m.generation;
 }
 
 struct Browser_OnBeforeBrowse {
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Identifier correlating an RPC request with its response.
+//
+// Ids generated here are a 64-bit sequence number sent as a plain JSON
+// integer. The browser process counts up from 1; each renderer process puts
+// a 20-bit prefix above a 32-bit counter. The browser process hands out the
+// prefixes in launch order on the child's command line, so ids from
+// different processes do not collide unless a renderer outlives the next
+// kMaxRpcIdPrefix child process launches. All ids stay below 2^52 for
+// clients that store them as doubles.
+//
+// Ids that clients send are echoed back unchanged: integers round-trip
+// through |value|, anything else (such as a UUID string) through |text|.
+struct RpcId {
+  uint64_t value = 0;
+  std::string text;
+};
+
+inline bool operator==(const RpcId& a, const RpcId& b) {
+  return a.value == b.value && a.text == b.text;
+}
+
+// How generated ids are written. Uuid keeps clients that expect UUID strings
+// working: the sequence number is embedded in the low 64 bits of an
+// otherwise zero UUID, and parsed back out of the client's response.
+enum class RpcIdFormat {
+  Integer,
+  Uuid,
+};
+
+// Prefixes handed to child processes are 1..kMaxRpcIdPrefix; 0 is the
+// browser process.
+inline constexpr uint32_t kMaxRpcIdPrefix = (1u << 20) - 1;
+
+namespace rpc_id_internal {
+
+inline std::atomic<RpcIdFormat> format{RpcIdFormat::Integer};
+inline uint64_t prefix = 0;
+inline std::atomic<uint32_t> counter{0};
+
+inline int HexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Recovers the sequence number from "00000000-0000-0000-xxxx-xxxxxxxxxxxx".
+// Returns 0, which is never generated, for any other string.
+inline uint64_t ParseUuidSequence(const std::string& text) {
+  static const char kZeroPrefix[] = "00000000-0000-0000-";
+  const size_t prefixLength = sizeof(kZeroPrefix) - 1;
+  if (text.size() != 36 || text.compare(0, prefixLength, kZeroPrefix) != 0 ||
+      text[23] != '-') {
+    return 0;
+  }
+  uint64_t value = 0;
+  for (size_t i = prefixLength; i < text.size(); ++i) {
+    if (i == 23) {
+      continue;
+    }
+    int digit = HexDigit(text[i]);
+    if (digit < 0) {
+      return 0;
+    }
+    value = (value << 4) | static_cast<uint64_t>(digit);
+  }
+  return value;
+}
+
+}  // namespace rpc_id_internal
+
+// Called once per process at startup, before any id is generated. |prefix|
+// is 0 in the browser process and at most kMaxRpcIdPrefix.
+inline void InitializeRpcIds(RpcIdFormat format, uint32_t prefix) {
+  rpc_id_internal::format.store(format);
+  rpc_id_internal::prefix = static_cast<uint64_t>(prefix & kMaxRpcIdPrefix)
+                            << 32;
+}
+
+inline RpcIdFormat GetRpcIdFormat() {
+  return rpc_id_internal::format.load(std::memory_order_relaxed);
+}
+
+inline RpcId NextRpcId() {
+  uint32_t sequence =
+      rpc_id_internal::counter.fetch_add(1, std::memory_order_relaxed) + 1;
+  RpcId id;
+  id.value = rpc_id_internal::prefix | sequence;
+  if (GetRpcIdFormat() == RpcIdFormat::Uuid) {
+    char buffer[37];
+    snprintf(buffer, sizeof(buffer), "00000000-0000-0000-%04x-%012" PRIx64,
+             static_cast<unsigned int>(id.value >> 48),
+             static_cast<uint64_t>(id.value & 0xFFFFFFFFFFFF));
+    id.text.assign(buffer, 36);
+  }
+  return id;
+}
+
+inline void to_json(json& j, const RpcId& m) {
+  if (m.text.empty()) {
+    j = m.value;
+  } else {
+    j = m.text;
+  }
+}
+
+inline void from_json(const json& j, RpcId& m) {
+  if (j.is_number_integer()) {
+    m.value = j.get<uint64_t>();
+    m.text.clear();
+  } else {
+    m.text = j.get<std::string>();
+    m.value = rpc_id_internal::ParseUuidSequence(m.text);
+  }
+}
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+// Registry of every RPC method known to the runner.
+//
+// Each method is declared exactly once below with a stable numeric id. Ids
+// are part of the wire protocol (clients may send "methodId" instead of
+// "class"/"method") so they must never be renumbered or reused; add new
+// methods with fresh ids. Client.GetSchema returns this table to clients.
+
+// Requests sent by the client:
+//   X(id, class, method, arguments type, thread the handler runs on)
+// Each entry is handled by BrowserProcessHandler::<class>_<method>Rpc.
+#define RPC_REQUESTS(X)                                                  \
+  X(1, Client, Handshake, Client_Handshake, Receive)                     \
+  X(2, Client, CreateBrowser, Client_CreateBrowser, UI)                  \
+  X(3, Client, Shutdown, std::monostate, UI)                             \
+  X(4, Client, GetSchema, std::monostate, Receive)                       \
+  X(5, Client, SetResponseTimeouts, Client_SetResponseTimeouts, Receive) \
+  X(6, Client, GetMetrics, std::monostate, Receive)                      \
+  X(7, Client, BeginFrames, Client_BeginFrames, UI)                      \
+  X(32, Browser, EvalJavaScript, std::monostate, Receive)                \
+  X(33, Browser, Reload, std::monostate, Receive)                        \
+  X(34, Browser, Focus, Browser_Focus, Receive)                          \
+  X(35, Browser, WasHidden, Browser_WasHidden, Receive)                  \
+  X(36, Browser, LoadUrl, Browser_LoadUrl, Receive)                      \
+  X(37, Browser, LoadRequest, Browser_LoadRequest, Receive)              \
+  X(38, Browser, WasResized, std::monostate, Receive)                    \
+  X(39, Browser, Cut, std::monostate, Receive)                           \
+  X(40, Browser, Copy, std::monostate, Receive)                          \
+  X(41, Browser, Paste, std::monostate, Receive)                         \
+  X(42, Browser, Delete, std::monostate, Receive)                        \
+  X(43, Browser, Undo, std::monostate, Receive)                          \
+  X(44, Browser, Redo, std::monostate, Receive)                          \
+  X(45, Browser, SelectAll, std::monostate, Receive)                     \
+  X(46, Browser, OnMouseClick, Browser_OnMouseClick, Receive)            \
+  X(47, Browser, OnMouseMove, Browser_OnMouseMove, Receive)              \
+  X(48, Browser, OnMouseWheel, Browser_OnMouseWheel, Receive)            \
+  X(49, Browser, OnKeyboardEvent, Browser_OnKeyboardEvent, Receive)      \
+  X(50, Browser, Close, Browser_Close, UI)                               \
+  X(51, Browser, TryClose, std::monostate, UI)                           \
+  X(52, Browser, DownloadImage, Browser_DownloadImage, Receive)          \
+  X(53, Browser, GetSource, std::monostate, Receive)                     \
+  X(54, Browser, GetFrameRate, std::monostate, UI)                       \
+  X(55, Browser, SetFrameRate, Browser_SetFrameRate, Receive)            \
+  X(56, Browser, SetGeometry, Browser_SetGeometry, UI)                   \
+  X(57, Browser, SetPaintOptions, Browser_SetPaintOptions, UI)           \
+  X(58, Browser, PaintAck, Browser_PaintAck, UI)                         \
+  X(59, Browser, SetFrameRateBounds, Browser_SetFrameRateBounds, UI)     \
+  X(60, Browser, BeginFrame, std::monostate, UI)                         \
+  X(61, Browser, SendInputBatch, Browser_SendInputBatch, UI)             \
+  X(62, Browser, SetSendWeight, Browser_SetSendWeight, Receive)
+
+// Requests and notifications sent to the client:
+//   X(id, class, method, arguments type, send priority)
+#define RPC_EVENTS(X)                                                         \
+  X(256, Client, OnLogMessage, json, Log)                                     \
+  X(288, Browser, GetViewRect, std::monostate, Blocking)                      \
+  X(289, Browser, OnPaint, Browser_OnPaint, Blocking)                         \
+  X(290, Browser, OnAcceleratedPaint, Browser_OnAcceleratedPaint, Blocking)   \
+  X(291, Browser, OnTextSelectionChanged,                                     \
+    Browser_OnTextSelectionChanged, Input)                                    \
+  X(292, Browser, GetScreenPoint, Browser_GetScreenPoint, Blocking)           \
+  X(293, Browser, OnPopupShow, Browser_OnPopupShow, Blocking)                 \
+  X(294, Browser, OnPopupSize, Browser_OnPopupSize, Blocking)                 \
+  X(295, Browser, OnTitleChange, Browser_OnTitleChange, State)                \
+  X(296, Browser, OnConsoleMessage, Browser_OnConsoleMessage, Log)            \
+  X(297, Browser, OnLoadingProgressChange,                                    \
+    Browser_OnLoadingProgressChange, State)                                   \
+  X(298, Browser, OnFaviconUrlChange, Browser_OnFaviconUrlChange, State)      \
+  X(299, Browser, OnCursorChange, Browser_OnCursorChange, Input)              \
+  X(300, Browser, OnBeforeClose, std::monostate, Blocking)                    \
+  X(301, Browser, OnBeforePopup, Browser_OnBeforePopup, Blocking)             \
+  X(302, Browser, OnBeforeBrowse, Browser_OnBeforeBrowse, Blocking)           \
+  X(303, Browser, OnOpenUrlFromTab, Browser_OnOpenUrlFromTab, Blocking)       \
+  X(304, Browser, OnBeforeContextMenu, Browser_OnBeforeContextMenu, Blocking) \
+  X(305, Browser, OnContextMenuCommand,                                       \
+    Browser_OnContextMenuCommand, Blocking)                                   \
+  X(306, Browser, OnLoadingStateChange, Browser_OnLoadingStateChange, State)  \
+  X(307, Browser, OnLoadStart, Browser_OnLoadStart, State)                    \
+  X(308, Browser, OnLoadEnd, Browser_OnLoadEnd, State)                        \
+  X(309, Browser, OnLoadError, Browser_OnLoadError, State)                    \
+  X(310, Browser, OnTooltip, Browser_OnTooltip, Input)                        \
+  X(311, Browser, OnMouseOver, Browser_OnMouseOver, Input)                    \
+  X(312, Browser, OnFocusOut, Browser_FocusOut, Input)                        \
+  X(313, Browser, OnFocusedNodeChanged, Browser_OnFocusedNodeChanged, Input)  \
+  X(314, Browser, OnPushState, Browser_OnPushState, State)                    \
+  X(315, Browser, OnReplaceState, Browser_OnReplaceState, State)              \
+  X(316, Browser, OnNavigateByUrl, Browser_OnNavigateByUrl, State)            \
+  X(317, Browser, OnNavigateByDelta, Browser_OnNavigateByDelta, State)        \
+  X(318, Browser, OnNavigateByKey, Browser_OnNavigateByKey, State)            \
+  X(319, Browser, OnPaintSurfaceCreated,                                      \
+    Browser_OnPaintSurfaceCreated, Blocking)
+
+enum class RpcMethodId : uint16_t {
+  Unknown = 0,
+#define RPC_REQUEST_ENUM(id, cls, method, arguments, thread) \
+  cls##_##method = id,
+#define RPC_EVENT_ENUM(id, cls, method, arguments, priority) \
+  cls##_##method = id,
+  RPC_REQUESTS(RPC_REQUEST_ENUM) RPC_EVENTS(RPC_EVENT_ENUM)
+#undef RPC_REQUEST_ENUM
+#undef RPC_EVENT_ENUM
+};
+
+enum class RpcClass {
+  Client,
+  Browser,
+};
+
+enum class RpcDirection {
+  Request,
+  Event,
+};
+
+// Thread an incoming request is handled on. Receive handlers run inline on
+// the RPC receive thread, UI handlers are posted to the CEF UI thread.
+enum class RpcThread {
+  None,
+  Receive,
+  UI,
+};
+
+// Lane an outgoing message is queued in. The send thread drains the lanes
+// in this order, but reserves part of every write for each lane so none of
+// them starves. Blocking holds the calls a CEF thread waits on, paints and
+// the popup events that place popup paints; Input holds events the user sees
+// change as they interact; State holds title, loading and navigation
+// updates; Log holds log and console messages. Responses to client requests
+// go out ahead of every lane. Messages are only ordered within a lane, so
+// events the client has to see in a fixed order relative to each other
+// share one.
+enum class RpcPriority {
+  Blocking,
+  Input,
+  State,
+  Log,
+};
+
+inline constexpr size_t kRpcPriorityCount = 4;
+
+inline const char* RpcThreadToString(RpcThread thread) {
+  switch (thread) {
+    case RpcThread::Receive:
+      return "receive";
+    case RpcThread::UI:
+      return "ui";
+    default:
+      return "none";
+  }
+}
+
+inline const char* RpcPriorityToString(RpcPriority priority) {
+  switch (priority) {
+    case RpcPriority::Blocking:
+      return "blocking";
+    case RpcPriority::Input:
+      return "input";
+    case RpcPriority::State:
+      return "state";
+    case RpcPriority::Log:
+      return "log";
+    default:
+      return "unknown";
+  }
+}
+
+struct RpcMethodInfo {
+  RpcMethodId id;
+  RpcClass rpcClass;
+  std::string_view className;
+  std::string_view methodName;
+  RpcDirection direction;
+  // C++ type of the arguments, e.g. "Browser_LoadUrl".
+  std::string_view argumentsName;
+  RpcThread thread;
+  // Lane of the message itself for events, of the response for requests.
+  RpcPriority priority;
+};
+
+// All methods, requests first. The position of an entry is its index in the
+// perfect hash table below.
+inline constexpr RpcMethodInfo kRpcMethods[] = {
+#define RPC_REQUEST_INFO(id, cls, method, arguments, thread)  \
+  {RpcMethodId::cls##_##method, RpcClass::cls, #cls, #method, \
+   RpcDirection::Request, #arguments, RpcThread::thread,       \
+   RpcPriority::Blocking},
+#define RPC_EVENT_INFO(id, cls, method, arguments, priority)  \
+  {RpcMethodId::cls##_##method, RpcClass::cls, #cls, #method, \
+   RpcDirection::Event, #arguments, RpcThread::None,           \
+   RpcPriority::priority},
+    RPC_REQUESTS(RPC_REQUEST_INFO) RPC_EVENTS(RPC_EVENT_INFO)
+#undef RPC_REQUEST_INFO
+#undef RPC_EVENT_INFO
+};
+
+inline constexpr size_t kRpcMethodCount =
+    sizeof(kRpcMethods) / sizeof(kRpcMethods[0]);
+inline constexpr uint8_t kNoRpcMethod = 0xFF;
+static_assert(kRpcMethodCount < kNoRpcMethod, "too many RPC methods");
+
+// Lookup by numeric id.
+
+constexpr size_t MaxRpcMethodId() {
+  size_t result = 0;
+  for (const RpcMethodInfo& info : kRpcMethods) {
+    if (static_cast<size_t>(info.id) > result) {
+      result = static_cast<size_t>(info.id);
+    }
+  }
+  return result;
+}
+
+inline constexpr size_t kMaxRpcMethodId = MaxRpcMethodId();
+
+constexpr std::array<uint8_t, kMaxRpcMethodId + 1> BuildRpcIdTable() {
+  std::array<uint8_t, kMaxRpcMethodId + 1> table{};
+  for (size_t i = 0; i < table.size(); ++i) {
+    table[i] = kNoRpcMethod;
+  }
+  for (size_t i = 0; i < kRpcMethodCount; ++i) {
+    table[static_cast<size_t>(kRpcMethods[i].id)] = static_cast<uint8_t>(i);
+  }
+  return table;
+}
+
+inline constexpr std::array<uint8_t, kMaxRpcMethodId + 1> kRpcIdTable =
+    BuildRpcIdTable();
+
+constexpr bool RpcMethodIdsAreUnique() {
+  size_t mapped = 0;
+  for (uint8_t index : kRpcIdTable) {
+    if (index != kNoRpcMethod) {
+      ++mapped;
+    }
+  }
+  return mapped == kRpcMethodCount;
+}
+
+static_assert(RpcMethodIdsAreUnique(), "duplicate RPC method id");
+
+inline const RpcMethodInfo* FindRpcMethod(uint32_t id) {
+  if (id > kMaxRpcMethodId || kRpcIdTable[id] == kNoRpcMethod) {
+    return nullptr;
+  }
+  return &kRpcMethods[kRpcIdTable[id]];
+}
+
+// Position of a known method in kRpcMethods, for per-method tables.
+inline size_t GetRpcMethodIndex(RpcMethodId id) {
+  return kRpcIdTable[static_cast<size_t>(id)];
+}
+
+inline const RpcMethodInfo& GetRpcMethodInfo(RpcMethodId id) {
+  return kRpcMethods[GetRpcMethodIndex(id)];
+}
+
+// Lookup by name, through a perfect hash computed at compile time. The seed
+// is searched for until every "class.method" pair lands in its own slot.
+
+inline constexpr size_t kRpcHashTableSize = 1024;
+
+constexpr uint32_t HashRpcName(std::string_view className,
+                               std::string_view methodName,
+                               uint32_t seed) {
+  uint32_t hash = 2166136261u ^ seed;
+  for (char c : className) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  hash = (hash ^ static_cast<uint8_t>('.')) * 16777619u;
+  for (char c : methodName) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  hash ^= hash >> 16;
+  hash *= 0x7feb352du;
+  hash ^= hash >> 15;
+  return hash;
+}
+
+constexpr bool BuildRpcHashTable(
+    uint32_t seed,
+    std::array<uint8_t, kRpcHashTableSize>& table) {
+  for (size_t i = 0; i < table.size(); ++i) {
+    table[i] = kNoRpcMethod;
+  }
+  for (size_t i = 0; i < kRpcMethodCount; ++i) {
+    size_t slot = HashRpcName(kRpcMethods[i].className,
+                              kRpcMethods[i].methodName, seed) &
+                  (kRpcHashTableSize - 1);
+    if (table[slot] != kNoRpcMethod) {
+      return false;
+    }
+    table[slot] = static_cast<uint8_t>(i);
+  }
+  return true;
+}
+
+constexpr uint32_t FindRpcHashSeed() {
+  for (uint32_t seed = 0; seed < 256; ++seed) {
+    std::array<uint8_t, kRpcHashTableSize> table{};
+    if (BuildRpcHashTable(seed, table)) {
+      return seed;
+    }
+  }
+  return UINT32_MAX;
+}
+
+inline constexpr uint32_t kRpcHashSeed = FindRpcHashSeed();
+static_assert(kRpcHashSeed != UINT32_MAX,
+              "no perfect hash seed found; duplicate RPC method name?");
+
+constexpr std::array<uint8_t, kRpcHashTableSize> MakeRpcHashTable() {
+  std::array<uint8_t, kRpcHashTableSize> table{};
+  BuildRpcHashTable(kRpcHashSeed, table);
+  return table;
+}
+
+inline constexpr std::array<uint8_t, kRpcHashTableSize> kRpcHashTable =
+    MakeRpcHashTable();
+
+inline const RpcMethodInfo* FindRpcMethod(std::string_view className,
+                                          std::string_view methodName) {
+  size_t slot = HashRpcName(className, methodName, kRpcHashSeed) &
+                (kRpcHashTableSize - 1);
+  uint8_t index = kRpcHashTable[slot];
+  if (index == kNoRpcMethod) {
+    return nullptr;
+  }
+  const RpcMethodInfo& info = kRpcMethods[index];
+  if (info.className != className || info.methodName != methodName) {
+    return nullptr;
+  }
+  return &info;
+}
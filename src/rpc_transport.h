@@ -0,0 +1,30 @@
+#pragma once
+
+// Byte stream carrying length-prefixed RPC frames between the runner and its
+// client. Read() is only called from the receive thread and Write()/Flush()
+// only from the send thread.
+class RpcTransport {
+ public:
+  virtual ~RpcTransport() {}
+
+  // Creates the server side endpoint. Called before the client is told that
+  // the runner is ready.
+  virtual bool Listen() = 0;
+
+  // Blocks until the client has attached to the endpoint.
+  virtual bool Accept() = 0;
+
+  // Blocks until data is available, then reads up to |size| bytes. Returns
+  // the number of bytes read, or -1 once the client is gone.
+  virtual int Read(void* buffer, int size) = 0;
+
+  // Writes |size| bytes, blocking while the client is not keeping up. Returns
+  // false once the client is gone.
+  virtual bool Write(const void* buffer, int size) = 0;
+
+  // Blocks until everything written so far has been handed off to the client.
+  virtual void Flush() = 0;
+
+  // Name used in log messages.
+  virtual const char* GetName() = 0;
+};
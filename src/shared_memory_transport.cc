@@ -0,0 +1,254 @@
+#include "shared_memory_transport.h"
+
+#include <SDL3/sdl.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Number of polls of an empty ring before parking on the doorbell. Keeps the
+// consumer off the kernel while the client is actively sending.
+const int kSpinCount = 4000;
+
+size_t HeaderSize() {
+  return (sizeof(SharedMemoryHeader) + 63) & ~static_cast<size_t>(63);
+}
+
+// |value| must be at most 2^31.
+uint32_t RoundUpToPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result < value) {
+    result <<= 1;
+  }
+  return result;
+}
+
+void CopyToRing(uint8_t* ring,
+                uint32_t capacity,
+                uint64_t position,
+                const uint8_t* source,
+                size_t size) {
+  size_t offset = static_cast<size_t>(position & (capacity - 1));
+  size_t first = std::min<size_t>(size, capacity - offset);
+  memcpy(ring + offset, source, first);
+  if (first < size) {
+    memcpy(ring, source + first, size - first);
+  }
+}
+
+void CopyFromRing(const uint8_t* ring,
+                  uint32_t capacity,
+                  uint64_t position,
+                  uint8_t* destination,
+                  size_t size) {
+  size_t offset = static_cast<size_t>(position & (capacity - 1));
+  size_t first = std::min<size_t>(size, capacity - offset);
+  memcpy(destination, ring + offset, first);
+  if (first < size) {
+    memcpy(destination + first, ring, size - first);
+  }
+}
+
+}  // namespace
+
+SharedMemoryTransport::SharedMemoryTransport(const std::wstring& name,
+                                             uint32_t ringCapacity,
+                                             HANDLE clientProcessHandle)
+    : name(name),
+      ringCapacity(RoundUpToPowerOfTwo(
+          std::clamp(ringCapacity, kMinRingCapacity, kMaxRingCapacity))),
+      clientProcessHandle(clientProcessHandle),
+      mapping(NULL),
+      header(nullptr) {}
+
+SharedMemoryTransport::~SharedMemoryTransport() {
+  for (Ring* ring : {&incoming, &outgoing}) {
+    if (ring->dataEvent) {
+      CloseHandle(ring->dataEvent);
+    }
+    if (ring->spaceEvent) {
+      CloseHandle(ring->spaceEvent);
+    }
+  }
+  if (header) {
+    UnmapViewOfFile(header);
+  }
+  if (mapping) {
+    CloseHandle(mapping);
+  }
+}
+
+bool SharedMemoryTransport::Listen() {
+  uint64_t mappingSize =
+      HeaderSize() + 2 * static_cast<uint64_t>(ringCapacity);
+  mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                               static_cast<DWORD>(mappingSize >> 32),
+                               static_cast<DWORD>(mappingSize), name.c_str());
+  if (mapping == NULL) {
+    SDL_Log("CreateFileMappingW failed for RPC transport: %lu",
+            GetLastError());
+    return false;
+  }
+  bool existing = GetLastError() == ERROR_ALREADY_EXISTS;
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  if (view == NULL) {
+    SDL_Log("MapViewOfFile failed for RPC transport: %lu", GetLastError());
+    return false;
+  }
+  header = static_cast<SharedMemoryHeader*>(view);
+
+  // The client may have created the mapping first, in which case its ring
+  // capacity wins. Fresh pagefile-backed mappings are zero filled, so the
+  // indices start out as an empty ring.
+  if (existing && header->magic == kMagic) {
+    if (header->version != kVersion) {
+      SDL_Log("Shared memory RPC version mismatch: %u != %u", header->version,
+              kVersion);
+      return false;
+    }
+    // The ring math masks positions with the capacity, and the rings have
+    // to fit the view, whose size the client chose as well.
+    uint32_t capacity = header->ringCapacity;
+    MEMORY_BASIC_INFORMATION viewInfo;
+    if (capacity < kMinRingCapacity || capacity > kMaxRingCapacity ||
+        (capacity & (capacity - 1)) != 0 ||
+        VirtualQuery(view, &viewInfo, sizeof(viewInfo)) == 0 ||
+        HeaderSize() + 2 * static_cast<uint64_t>(capacity) >
+            viewInfo.RegionSize) {
+      SDL_Log("Shared memory RPC ring capacity %u is invalid", capacity);
+      return false;
+    }
+    ringCapacity = capacity;
+  } else {
+    header->version = kVersion;
+    header->ringCapacity = ringCapacity;
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = kMagic;
+  }
+
+  uint8_t* base = static_cast<uint8_t*>(view);
+  incoming.indices = &header->toRunner;
+  incoming.data = base + HeaderSize();
+  outgoing.indices = &header->toClient;
+  outgoing.data = base + HeaderSize() + ringCapacity;
+  if (!OpenRing(incoming, L".ToRunner") || !OpenRing(outgoing, L".ToClient")) {
+    return false;
+  }
+
+  SDL_Log("Shared memory RPC transport ready (%u byte rings)", ringCapacity);
+  return true;
+}
+
+bool SharedMemoryTransport::OpenRing(Ring& ring, const wchar_t* direction) {
+  std::wstring prefix = name + direction;
+  ring.dataEvent =
+      CreateEventW(NULL, FALSE, FALSE, (prefix + L".Data").c_str());
+  ring.spaceEvent =
+      CreateEventW(NULL, FALSE, FALSE, (prefix + L".Space").c_str());
+  if (ring.dataEvent == NULL || ring.spaceEvent == NULL) {
+    SDL_Log("CreateEventW failed for RPC transport: %lu", GetLastError());
+    return false;
+  }
+  return true;
+}
+
+bool SharedMemoryTransport::Accept() {
+  // There is no connection step: the client attaches by opening the mapping,
+  // and anything written before that waits in the ring.
+  return true;
+}
+
+bool SharedMemoryTransport::WaitForDoorbell(HANDLE event) {
+  HANDLE handles[] = {event, clientProcessHandle};
+  DWORD result = WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+  if (result == WAIT_OBJECT_0) {
+    return true;
+  }
+  if (result == WAIT_OBJECT_0 + 1) {
+    SDL_Log("Client process exited, closing shared memory RPC transport");
+  } else {
+    SDL_Log("WaitForMultipleObjects failed: %lu", GetLastError());
+  }
+  return false;
+}
+
+int SharedMemoryTransport::Read(void* buffer, int size) {
+  SharedRingIndices* ring = incoming.indices;
+  uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+  uint64_t head = ring->head.load(std::memory_order_acquire);
+
+  for (int spin = 0; head == tail && spin < kSpinCount; ++spin) {
+    YieldProcessor();
+    head = ring->head.load(std::memory_order_acquire);
+  }
+
+  while (head == tail) {
+    ring->consumerWaiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    head = ring->head.load(std::memory_order_acquire);
+    if (head == tail && !WaitForDoorbell(incoming.dataEvent)) {
+      ring->consumerWaiting.store(0, std::memory_order_relaxed);
+      return -1;
+    }
+    ring->consumerWaiting.store(0, std::memory_order_relaxed);
+    head = ring->head.load(std::memory_order_acquire);
+  }
+
+  size_t count = std::min<uint64_t>(static_cast<uint64_t>(size), head - tail);
+  CopyFromRing(incoming.data, ringCapacity, tail,
+               static_cast<uint8_t*>(buffer), count);
+  ring->tail.store(tail + count, std::memory_order_release);
+
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (ring->producerWaiting.load(std::memory_order_relaxed)) {
+    SetEvent(incoming.spaceEvent);
+  }
+  return static_cast<int>(count);
+}
+
+bool SharedMemoryTransport::Write(const void* buffer, int size) {
+  SharedRingIndices* ring = outgoing.indices;
+  const uint8_t* source = static_cast<const uint8_t*>(buffer);
+  size_t remaining = static_cast<size_t>(size);
+
+  while (remaining > 0) {
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    uint64_t tail = ring->tail.load(std::memory_order_acquire);
+    size_t space = ringCapacity - static_cast<size_t>(head - tail);
+
+    if (space == 0) {
+      ring->producerWaiting.store(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      tail = ring->tail.load(std::memory_order_acquire);
+      bool full = head - tail == ringCapacity;
+      if (full && !WaitForDoorbell(outgoing.spaceEvent)) {
+        ring->producerWaiting.store(0, std::memory_order_relaxed);
+        return false;
+      }
+      ring->producerWaiting.store(0, std::memory_order_relaxed);
+      continue;
+    }
+
+    size_t count = std::min(space, remaining);
+    CopyToRing(outgoing.data, ringCapacity, head, source, count);
+    ring->head.store(head + count, std::memory_order_release);
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (ring->consumerWaiting.load(std::memory_order_relaxed)) {
+      SetEvent(outgoing.dataEvent);
+    }
+
+    source += count;
+    remaining -= count;
+  }
+  return true;
+}
+
+void SharedMemoryTransport::Flush() {
+  // Written bytes are visible to the client as soon as head is published.
+}
+
+const char* SharedMemoryTransport::GetName() {
+  return "shared memory";
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <windows.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "rpc_transport.h"
+
+// Indices of one single-producer/single-consumer byte ring. |head| and |tail|
+// count bytes ever produced and consumed, so the ring is empty when they are
+// equal and full when they differ by the capacity.
+struct SharedRingIndices {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  // Set by a side that is about to park on its doorbell event. The other side
+  // only signals the event when it observes the flag.
+  alignas(64) std::atomic<uint32_t> consumerWaiting;
+  alignas(64) std::atomic<uint32_t> producerWaiting;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "shared memory rings require lock-free 64-bit atomics");
+
+// Header at the start of the shared mapping. The ring data follows it, first
+// the client-to-runner ring, then the runner-to-client ring, each
+// |ringCapacity| bytes long.
+struct SharedMemoryHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t ringCapacity;
+  uint32_t reserved;
+  alignas(64) SharedRingIndices toRunner;
+  alignas(64) SharedRingIndices toClient;
+};
+
+// RPC transport over a pair of lock-free rings in a named file mapping.
+//
+// The client opens the mapping "<name>" and the auto-reset events
+// "<name>.ToRunner.Data", "<name>.ToRunner.Space", "<name>.ToClient.Data" and
+// "<name>.ToClient.Space". A consumer that finds its ring empty spins briefly,
+// then sets consumerWaiting, re-checks and parks on the Data event; producers
+// only signal that event when they see the flag set. The Space events work
+// the same way for a producer blocked on a full ring. Frames use the same
+// length-prefixed layout as the socket transport.
+class SharedMemoryTransport : public RpcTransport {
+ public:
+  static constexpr uint32_t kMagic = 0x43505252;  // "CPRR"
+  static constexpr uint32_t kVersion = 1;
+  // Bounds of the ring capacity, which is rounded up to a power of two.
+  static constexpr uint32_t kMinRingCapacity = 64 * 1024;
+  static constexpr uint32_t kMaxRingCapacity = 256 * 1024 * 1024;
+
+  // |ringCapacity| is clamped to kMinRingCapacity..kMaxRingCapacity.
+  SharedMemoryTransport(const std::wstring& name,
+                        uint32_t ringCapacity,
+                        HANDLE clientProcessHandle);
+  ~SharedMemoryTransport() override;
+
+  bool Listen() override;
+  bool Accept() override;
+  int Read(void* buffer, int size) override;
+  bool Write(const void* buffer, int size) override;
+  void Flush() override;
+  const char* GetName() override;
+
+ private:
+  struct Ring {
+    SharedRingIndices* indices = nullptr;
+    uint8_t* data = nullptr;
+    HANDLE dataEvent = NULL;
+    HANDLE spaceEvent = NULL;
+  };
+
+  bool OpenRing(Ring& ring, const wchar_t* direction);
+  bool WaitForDoorbell(HANDLE event);
+
+  std::wstring name;
+  uint32_t ringCapacity;
+  HANDLE clientProcessHandle;
+  HANDLE mapping;
+  SharedMemoryHeader* header;
+  Ring incoming;
+  Ring outgoing;
+};
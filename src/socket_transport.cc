@@ -0,0 +1,75 @@
+#include "socket_transport.h"
+
+#include <SDL3/sdl.h>
+
+SocketTransport::SocketTransport(Uint16 port)
+    : port(port), server(nullptr), stream(nullptr) {}
+
+SocketTransport::~SocketTransport() {
+  if (stream) {
+    NET_DestroyStreamSocket(stream);
+  }
+  if (server) {
+    NET_DestroyServer(server);
+  }
+}
+
+bool SocketTransport::Listen() {
+  if (!NET_Init()) {
+    SDL_Log("NET_Init failed: %s", SDL_GetError());
+    return false;
+  }
+
+  server = NET_CreateServer(NULL, port);
+  if (server == NULL) {
+    SDL_Log("NET_CreateServer failed: %s", SDL_GetError());
+    return false;
+  }
+
+  SDL_Log("Server started on port %u", static_cast<unsigned int>(port));
+  return true;
+}
+
+bool SocketTransport::Accept() {
+  void* waitSockets[] = {static_cast<void*>(server)};
+  NET_WaitUntilInputAvailable(waitSockets, 1, -1);
+
+  if (!NET_AcceptClient(server, &stream)) {
+    SDL_Log("Accept error: %s", SDL_GetError());
+    return false;
+  }
+  if (!stream) {
+    SDL_Log("No client connected after WaitUntilInputAvailable");
+    return false;
+  }
+  return true;
+}
+
+int SocketTransport::Read(void* buffer, int size) {
+  // Block until the client sends data.
+  void* waitSockets[] = {static_cast<void*>(stream)};
+  NET_WaitUntilInputAvailable(waitSockets, 1, -1);
+
+  int received = NET_ReadFromStreamSocket(stream, buffer, size);
+  if (received < 0) {
+    SDL_Log("Read error: %s", SDL_GetError());
+  }
+  return received;
+}
+
+bool SocketTransport::Write(const void* buffer, int size) {
+  if (!NET_WriteToStreamSocket(stream, buffer, size)) {
+    SDL_Log("NET_WriteToStreamSocket failed or connection closed: %s",
+            SDL_GetError());
+    return false;
+  }
+  return true;
+}
+
+void SocketTransport::Flush() {
+  NET_WaitUntilStreamSocketDrained(stream, -1);
+}
+
+const char* SocketTransport::GetName() {
+  return "socket";
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "SDL3_net/SDL_net.h"
+#include "rpc_transport.h"
+
+// RPC transport over a localhost TCP connection.
+class SocketTransport : public RpcTransport {
+ public:
+  explicit SocketTransport(Uint16 port);
+  ~SocketTransport() override;
+
+  bool Listen() override;
+  bool Accept() override;
+  int Read(void* buffer, int size) override;
+  bool Write(const void* buffer, int size) override;
+  void Flush() override;
+  const char* GetName() override;
+
+ private:
+  Uint16 port;
+  NET_Server* server;
+  NET_StreamSocket* stream;
+};
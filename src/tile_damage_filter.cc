@@ -0,0 +1,94 @@
+#include "tile_damage_filter.h"
+
+#include <algorithm>
+
+#include "pixel_ops.h"
+
+std::vector<CefRect> TileDamageFilter::Filter(
+    const uint8_t* pixels,
+    int newWidth,
+    int newHeight,
+    const std::vector<CefRect>& dirtyRects) {
+  if (hashes.empty() || newWidth != width || newHeight != height) {
+    width = newWidth;
+    height = newHeight;
+    columns = (width + kTileSize - 1) / kTileSize;
+    rows = (height + kTileSize - 1) / kTileSize;
+    hashes.assign(static_cast<size_t>(columns) * rows, 0);
+    HashAll(pixels);
+    return {CefRect(0, 0, width, height)};
+  }
+
+  std::vector<bool> touched(hashes.size(), false);
+  for (const CefRect& rect : dirtyRects) {
+    int left = std::max(rect.x, 0) / kTileSize;
+    int top = std::max(rect.y, 0) / kTileSize;
+    int right = std::min(rect.x + rect.width, width);
+    int bottom = std::min(rect.y + rect.height, height);
+    if (right <= 0 || bottom <= 0) {
+      continue;
+    }
+    right = (right - 1) / kTileSize;
+    bottom = (bottom - 1) / kTileSize;
+    for (int row = top; row <= bottom; ++row) {
+      for (int column = left; column <= right; ++column) {
+        touched[row * columns + column] = true;
+      }
+    }
+  }
+
+  // Runs of changed tiles in a row become one rectangle, which keeps the
+  // list short for MergeDirtyRects.
+  size_t stride = static_cast<size_t>(width) * 4;
+  std::vector<CefRect> changed;
+  for (int row = 0; row < rows; ++row) {
+    int runStart = -1;
+    for (int column = 0; column <= columns; ++column) {
+      bool isChanged = false;
+      if (column < columns && touched[row * columns + column]) {
+        uint64_t hash =
+            HashPixelRect(pixels, stride, GetTileRect(column, row));
+        uint64_t& previous = hashes[row * columns + column];
+        isChanged = hash != previous;
+        previous = hash;
+      }
+      if (isChanged && runStart < 0) {
+        runStart = column;
+      } else if (!isChanged && runStart >= 0) {
+        CefRect first = GetTileRect(runStart, row);
+        CefRect last = GetTileRect(column - 1, row);
+        changed.push_back(CefRect(first.x, first.y,
+                                  last.x + last.width - first.x,
+                                  first.height));
+        runStart = -1;
+      }
+    }
+  }
+  return MergeDirtyRects(changed, CefRect(0, 0, width, height));
+}
+
+void TileDamageFilter::Reset() {
+  width = 0;
+  height = 0;
+  columns = 0;
+  rows = 0;
+  hashes.clear();
+  hashes.shrink_to_fit();
+}
+
+void TileDamageFilter::HashAll(const uint8_t* pixels) {
+  size_t stride = static_cast<size_t>(width) * 4;
+  for (int row = 0; row < rows; ++row) {
+    for (int column = 0; column < columns; ++column) {
+      hashes[row * columns + column] =
+          HashPixelRect(pixels, stride, GetTileRect(column, row));
+    }
+  }
+}
+
+CefRect TileDamageFilter::GetTileRect(int column, int row) const {
+  int x = column * kTileSize;
+  int y = row * kTileSize;
+  return CefRect(x, y, std::min(kTileSize, width - x),
+                 std::min(kTileSize, height - y));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "include/internal/cef_types_wrappers.h"
+
+// Narrows the dirty rectangles CEF reports down to what really changed.
+//
+// The view is split into fixed tiles and a hash of every tile is kept from
+// the previous frame. Only tiles touched by a dirty rectangle are hashed
+// again; those whose hash is unchanged are dropped from the damage. Chromium
+// regularly invalidates regions without changing a pixel, and such frames
+// end up with no damage at all.
+class TileDamageFilter {
+ public:
+  static constexpr int kTileSize = 64;
+
+  // Returns the changed part of |dirtyRects| as merged rectangles. The first
+  // frame after a size change is returned in full.
+  std::vector<CefRect> Filter(const uint8_t* pixels,
+                              int width,
+                              int height,
+                              const std::vector<CefRect>& dirtyRects);
+
+  // Forgets the previous frame.
+  void Reset();
+
+ private:
+  void HashAll(const uint8_t* pixels);
+  CefRect GetTileRect(int column, int row) const;
+
+  int width = 0;
+  int height = 0;
+  int columns = 0;
+  int rows = 0;
+  std::vector<uint64_t> hashes;
+};
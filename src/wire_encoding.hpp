@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "json.hpp"
+
+using json = nlohmann::json;
+
+// Encoding of RPC frame payloads. Frames are JSON text until the client sends
+// a Client.Handshake request selecting another encoding. The handshake
+// response is still JSON; every frame after it, in both directions, uses the
+// selected encoding.
+enum class WireEncoding {
+  Json,
+  Cbor,
+  MessagePack,
+};
+
+inline std::optional<WireEncoding> WireEncodingFromString(
+    const std::string& name) {
+  if (name == "json") {
+    return WireEncoding::Json;
+  }
+  if (name == "cbor") {
+    return WireEncoding::Cbor;
+  }
+  if (name == "msgpack") {
+    return WireEncoding::MessagePack;
+  }
+  return std::nullopt;
+}
+
+inline const char* WireEncodingToString(WireEncoding encoding) {
+  switch (encoding) {
+    case WireEncoding::Json:
+      return "json";
+    case WireEncoding::Cbor:
+      return "cbor";
+    case WireEncoding::MessagePack:
+      return "msgpack";
+    default:
+      return "unknown";
+  }
+}
+
+inline std::string EncodeMessage(const json& message, WireEncoding encoding) {
+  std::string payload;
+  switch (encoding) {
+    case WireEncoding::Cbor:
+      json::to_cbor(message, payload);
+      break;
+    case WireEncoding::MessagePack:
+      json::to_msgpack(message, payload);
+      break;
+    default:
+      payload = message.dump();
+      break;
+  }
+  return payload;
+}
+
+// Throws nlohmann::json::parse_error on malformed input.
+inline json DecodeMessage(const uint8_t* data,
+                          size_t size,
+                          WireEncoding encoding) {
+  switch (encoding) {
+    case WireEncoding::Cbor:
+      return json::from_cbor(data, data + size);
+    case WireEncoding::MessagePack:
+      return json::from_msgpack(data, data + size);
+    default:
+      return json::parse(data, data + size);
+  }
+}
+
+// Byte arrays go out as native byte strings in the binary encodings and as
+// arrays of integers in JSON.
+inline json BytesToJson(const std::vector<uint8_t>& bytes,
+                        WireEncoding encoding) {
+  if (encoding == WireEncoding::Json) {
+    return bytes;
+  }
+  return json::binary(bytes);
+}
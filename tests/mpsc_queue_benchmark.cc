@@ -0,0 +1,115 @@
+#include <SDL3/sdl.h>
+#include <chrono>
+#include <cstdio>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mpsc_queue.hpp"
+
+// Times the outgoing message ingress: producers push small strings, the
+// consumer drains them in batches like the send thread does. MpscQueue is
+// compared against the mutex and condition variable queue it replaced.
+
+namespace {
+
+const int kMessageCount = 1 << 20;
+const size_t kMessageSize = 64;
+
+// The draining part of the former ThreadSafeQueue, unchanged.
+template <typename T>
+class MutexQueue {
+ public:
+  MutexQueue() {
+    mutex = SDL_CreateMutex();
+    condition = SDL_CreateCondition();
+  }
+
+  ~MutexQueue() {
+    SDL_DestroyMutex(mutex);
+    SDL_DestroyCondition(condition);
+  }
+
+  void Push(T&& value) {
+    SDL_LockMutex(mutex);
+    queue.push(std::move(value));
+    SDL_SignalCondition(condition);
+    SDL_UnlockMutex(mutex);
+  }
+
+  void PopAll(std::vector<T>& out) {
+    SDL_LockMutex(mutex);
+    while (queue.empty()) {
+      SDL_WaitCondition(condition, mutex);
+    }
+    while (!queue.empty()) {
+      out.push_back(std::move(queue.front()));
+      queue.pop();
+    }
+    SDL_UnlockMutex(mutex);
+  }
+
+ private:
+  SDL_Mutex* mutex;
+  SDL_Condition* condition;
+  std::queue<T> queue;
+};
+
+// Runs |producers| threads pushing kMessageCount messages in total through
+// |push| while the calling thread takes them with |drain|. Returns the
+// nanoseconds per message.
+template <typename Push, typename Drain>
+double NanosecondsPerMessage(int producers, Push push, Drain drain) {
+  int perProducer = kMessageCount / producers;
+  int total = perProducer * producers;
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < producers; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < perProducer; ++j) {
+        push(std::string(kMessageSize, 'x'));
+      }
+    });
+  }
+  std::vector<std::string> batch;
+  int received = 0;
+  while (received < total) {
+    batch.clear();
+    drain(batch);
+    received += static_cast<int>(batch.size());
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / total;
+}
+
+}  // namespace
+
+int main() {
+  printf("%-10s %16s %16s\n", "producers", "mutex ns/msg", "mpsc ns/msg");
+  for (int producers = 1; producers <= 16; producers *= 2) {
+    MutexQueue<std::string> mutexQueue;
+    double mutexTime = NanosecondsPerMessage(
+        producers,
+        [&](std::string&& message) { mutexQueue.Push(std::move(message)); },
+        [&](std::vector<std::string>& out) { mutexQueue.PopAll(out); });
+
+    // The capacity of the outgoing message ingress.
+    MpscQueue<std::string, 1024> mpscQueue;
+    double mpscTime = NanosecondsPerMessage(
+        producers,
+        [&](std::string&& message) { mpscQueue.Push(std::move(message)); },
+        [&](std::vector<std::string>& out) {
+          if (mpscQueue.Drain(out) == 0) {
+            mpscQueue.Wait();
+          }
+        });
+
+    printf("%-10d %16.1f %16.1f\n", producers, mutexTime, mpscTime);
+  }
+  return 0;
+}
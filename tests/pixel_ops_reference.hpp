@@ -0,0 +1,56 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "pixel_ops.h"
+
+// Straightforward per-pixel versions of the pixel_ops routines, for checking
+// and timing the optimized ones against.
+
+inline void ReferenceConvertPixel(uint8_t* pixel,
+                                  const PixelConversion& conversion) {
+  if (conversion.unpremultiply && pixel[3] != 255) {
+    uint32_t alpha = pixel[3];
+    uint32_t factor = alpha == 0 ? 0 : (255 * 65536 + alpha / 2) / alpha;
+    for (int channel = 0; channel < 3; ++channel) {
+      uint32_t value = (pixel[channel] * factor + 32768) >> 16;
+      pixel[channel] = static_cast<uint8_t>(std::min(value, 255u));
+    }
+  }
+  if (conversion.format == PixelFormat::Rgba) {
+    std::swap(pixel[0], pixel[2]);
+  }
+}
+
+inline void ReferenceConvertPixelRect(uint8_t* destination,
+                                      size_t destinationStride,
+                                      const uint8_t* source,
+                                      size_t sourceStride,
+                                      int sourceWidth,
+                                      int sourceHeight,
+                                      const CefRect& rect,
+                                      const PixelConversion& conversion) {
+  for (int y = rect.y; y < rect.y + rect.height; ++y) {
+    for (int x = rect.x; x < rect.x + rect.width; ++x) {
+      uint8_t* pixel = destination + y * destinationStride + x * 4;
+      if (conversion.scaleDivisor == 2) {
+        int left = x * 2;
+        int right = std::min(left + 1, sourceWidth - 1);
+        int top = y * 2;
+        int bottom = std::min(top + 1, sourceHeight - 1);
+        for (int channel = 0; channel < 4; ++channel) {
+          int sum = source[top * sourceStride + left * 4 + channel] +
+                    source[top * sourceStride + right * 4 + channel] +
+                    source[bottom * sourceStride + left * 4 + channel] +
+                    source[bottom * sourceStride + right * 4 + channel];
+          pixel[channel] = static_cast<uint8_t>((sum + 2) / 4);
+        }
+      } else {
+        std::copy_n(source + y * sourceStride + x * 4, 4, pixel);
+      }
+      ReferenceConvertPixel(pixel, conversion);
+    }
+  }
+}
@@ -0,0 +1,184 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "pixel_ops.h"
+#include "pixel_ops_reference.hpp"
+
+// Checks the SIMD paths of pixel_ops against pixel_ops_reference.hpp. Every
+// width from 1 to kMaxWidth is covered, so each vector loop is exercised
+// together with every length of its scalar tail.
+
+namespace {
+
+const int kMaxWidth = 40;
+const int kMaxHeight = 6;
+
+int failures = 0;
+
+void Expect(bool condition, const char* what, int width, int height) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s (%dx%d)\n", what, width, height);
+    failures++;
+  }
+}
+
+std::vector<uint8_t> RandomPixels(std::mt19937& random, size_t size) {
+  std::vector<uint8_t> pixels(size);
+  for (uint8_t& value : pixels) {
+    value = static_cast<uint8_t>(random());
+  }
+  return pixels;
+}
+
+// Mostly opaque pixels, so UnpremultiplyRow takes both its fast path and
+// the per-pixel one.
+void MakeMostlyOpaque(std::mt19937& random, std::vector<uint8_t>& pixels) {
+  for (size_t i = 3; i < pixels.size(); i += 4) {
+    if (random() % 4 != 0) {
+      pixels[i] = 255;
+    }
+  }
+}
+
+void TestDownscaleRounding() {
+  // Sums of 1 and 2 round down, 3 rounds up. Averaging pairwise would round
+  // up both times and give 1 for all of them.
+  const uint8_t values[] = {1, 2, 3};
+  for (uint8_t value : values) {
+    const int width = 16;
+    std::vector<uint8_t> source(width * 2 * 4, 0);
+    for (int x = 0; x < width; x += 2) {
+      for (int channel = 0; channel < 4; ++channel) {
+        source[x * 4 + channel] = value;
+      }
+    }
+    std::vector<uint8_t> destination(width / 2 * 4, 0xAA);
+    PixelConversion conversion;
+    conversion.scaleDivisor = 2;
+    ConvertPixelRect(destination.data(), width / 2 * 4, source.data(),
+                     width * 4, width, 2, CefRect(0, 0, width / 2, 1),
+                     conversion);
+    uint8_t expected = static_cast<uint8_t>((value + 2) / 4);
+    bool matches = true;
+    for (uint8_t result : destination) {
+      matches = matches && result == expected;
+    }
+    Expect(matches, "downscale rounds half up", width, 2);
+  }
+}
+
+void TestConvertMatchesReference(std::mt19937& random) {
+  for (int width = 1; width <= kMaxWidth; ++width) {
+    for (int height = 1; height <= kMaxHeight; ++height) {
+      std::vector<uint8_t> source = RandomPixels(random, width * height * 4);
+      MakeMostlyOpaque(random, source);
+      for (int divisor = 1; divisor <= 2; ++divisor) {
+        for (int flags = 0; flags < 4; ++flags) {
+          PixelConversion conversion;
+          conversion.scaleDivisor = divisor;
+          conversion.unpremultiply = (flags & 1) != 0;
+          conversion.format =
+              (flags & 2) != 0 ? PixelFormat::Rgba : PixelFormat::Bgra;
+
+          int outputWidth = ScaledPixelSize(width, conversion);
+          int outputHeight = ScaledPixelSize(height, conversion);
+          // Also an output rectangle not starting at the origin.
+          int x = static_cast<int>(random() % outputWidth);
+          int y = static_cast<int>(random() % outputHeight);
+          const CefRect rects[] = {
+              CefRect(0, 0, outputWidth, outputHeight),
+              CefRect(x, y, outputWidth - x, outputHeight - y)};
+          for (const CefRect& rect : rects) {
+            size_t stride = static_cast<size_t>(outputWidth) * 4;
+            std::vector<uint8_t> actual(stride * outputHeight, 0xAA);
+            std::vector<uint8_t> expected(actual);
+            ConvertPixelRect(actual.data(), stride, source.data(), width * 4,
+                             width, height, rect, conversion);
+            ReferenceConvertPixelRect(expected.data(), stride, source.data(),
+                                      width * 4, width, height, rect,
+                                      conversion);
+            Expect(actual == expected, "ConvertPixelRect matches reference",
+                   width, height);
+          }
+        }
+      }
+    }
+  }
+}
+
+void TestCopyPixelRect(std::mt19937& random) {
+  for (int width = 1; width <= kMaxWidth; ++width) {
+    const int height = 3;
+    std::vector<uint8_t> source = RandomPixels(random, width * height * 4);
+    std::vector<uint8_t> actual(source.size(), 0);
+    std::vector<uint8_t> expected(actual);
+    int x = static_cast<int>(random() % width);
+    CefRect rect(x, 1, width - x, 1);
+    CopyPixelRect(actual.data(), width * 4, source.data(), width * 4, rect);
+    memcpy(expected.data() + width * 4 + x * 4,
+           source.data() + width * 4 + x * 4, (width - x) * 4);
+    Expect(actual == expected, "CopyPixelRect copies only the rectangle",
+           width, height);
+  }
+}
+
+void TestHashPixelRect(std::mt19937& random) {
+  for (int width = 1; width <= kMaxWidth; ++width) {
+    const int height = 4;
+    // The same pixels at two places in one buffer hash the same.
+    std::vector<uint8_t> pixels = RandomPixels(random, width * 2 * height * 4);
+    size_t stride = static_cast<size_t>(width) * 2 * 4;
+    for (int y = 0; y < height; ++y) {
+      memcpy(pixels.data() + y * stride + width * 4,
+             pixels.data() + y * stride, width * 4);
+    }
+    CefRect left(0, 0, width, height);
+    CefRect right(width, 0, width, height);
+    Expect(HashPixelRect(pixels.data(), stride, left) ==
+               HashPixelRect(pixels.data(), stride, right),
+           "HashPixelRect depends only on the pixels", width, height);
+
+    pixels[(height - 1) * stride + (width * 2 - 1) * 4] ^= 1;
+    Expect(HashPixelRect(pixels.data(), stride, left) !=
+               HashPixelRect(pixels.data(), stride, right),
+           "HashPixelRect sees a changed last pixel", width, height);
+  }
+}
+
+void TestMergeDirtyRects() {
+  CefRect bounds(0, 0, 100, 100);
+  std::vector<CefRect> merged = MergeDirtyRects(
+      {CefRect(0, 0, 10, 10), CefRect(5, 5, 10, 10), CefRect(50, 50, 5, 5),
+       CefRect(90, 90, 20, 20), CefRect(200, 200, 5, 5)},
+      bounds);
+  bool matches = merged.size() == 3 && merged[0] == CefRect(0, 0, 15, 15) &&
+                 merged[1] == CefRect(50, 50, 5, 5) &&
+                 merged[2] == CefRect(90, 90, 10, 10);
+  Expect(matches, "MergeDirtyRects merges and clips", 100, 100);
+
+  // Joining two rectangles can make the result overlap a third.
+  merged = MergeDirtyRects(
+      {CefRect(0, 0, 10, 10), CefRect(20, 0, 10, 10), CefRect(5, 0, 20, 5)},
+      bounds);
+  Expect(merged.size() == 1 && merged[0] == CefRect(0, 0, 30, 10),
+         "MergeDirtyRects merges transitively", 100, 100);
+}
+
+}  // namespace
+
+int main() {
+  std::mt19937 random(1);
+  TestDownscaleRounding();
+  TestConvertMatchesReference(random);
+  TestCopyPixelRect(random);
+  TestHashPixelRect(random);
+  TestMergeDirtyRects();
+  if (failures > 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+  printf("All pixel_ops checks passed\n");
+  return 0;
+}